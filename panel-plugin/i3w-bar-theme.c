@@ -0,0 +1,135 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "i3w-bar-theme.h"
+
+/*
+ * The selectors with the colors of the bar they take, and the i3bar
+ * defaults used for the colors not set in the i3 config.
+ */
+typedef struct
+{
+    const gchar *selector;
+    const gchar *color;
+    const gchar *default_color;
+    const gchar *background;
+    const gchar *default_background;
+} i3wBarThemeRule;
+
+static const i3wBarThemeRule rules[] =
+{
+    { ".workspace",
+        "inactive_workspace_text", "#888888", "inactive_workspace_bg", "#222222" },
+    { ".workspace.visible",
+        "active_workspace_text", "#ffffff", "active_workspace_bg", "#5f676a" },
+    { ".workspace.focused",
+        "focused_workspace_text", "#ffffff", "focused_workspace_bg", "#285577" },
+    { ".workspace.urgent",
+        "urgent_workspace_text", "#ffffff", "urgent_workspace_bg", "#900000" },
+    { ".binding-mode",
+        "binding_mode_text", "#ffffff", "binding_mode_bg", "#900000" }
+};
+
+/*
+ * Prototypes
+ */
+static void
+append_color(GString *css, GHashTable *colors, const gchar *name, const gchar *fallback);
+
+/*
+ * Implementations of public functions
+ */
+
+/**
+ * i3w_bar_theme_css:
+ * @colors: the colors of the bar, see i3wm_get_bar_colors
+ *
+ * Generate the stylesheet of the buttons from the colors of the bar.
+ *
+ * Returns: the stylesheet, free it with g_free()
+ */
+gchar *
+i3w_bar_theme_css(GHashTable *colors)
+{
+    GString *css = g_string_new(NULL);
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(rules); i++)
+    {
+        g_string_append_printf(css, "%s {\n  color: ", rules[i].selector);
+        append_color(css, colors, rules[i].color, rules[i].default_color);
+        g_string_append(css, ";\n  background-image: none;\n  background-color: ");
+        append_color(css, colors, rules[i].background, rules[i].default_background);
+        g_string_append(css, ";\n}\n");
+    }
+    g_string_append(css, ".workspace.focused {\n  font-weight: bold;\n}\n");
+    g_string_append(css, ".workspace.empty {\n  opacity: 0.5;\n}\n");
+
+    return g_string_free(css, FALSE);
+}
+
+/*
+ * Implementations of private functions
+ */
+
+/**
+ * append_color:
+ * @css: the stylesheet being built
+ * @colors: the colors of the bar
+ * @name: the name of the color
+ * @fallback: the color used when it is not set or not valid
+ *
+ * Append the color as CSS. i3 colors are #rrggbb or #rrggbbaa, the latter
+ * is not understood by GTK 3 and is written as rgba().
+ */
+static void
+append_color(GString *css, GHashTable *colors, const gchar *name, const gchar *fallback)
+{
+    const gchar *color = colors ? g_hash_table_lookup(colors, name) : NULL;
+    gsize len = color ? strlen(color) : 0;
+    guint channels[4] = { 0, 0, 0, 255 };
+    guint i;
+
+    if (color == NULL || color[0] != '#' || (len != 7 && len != 9))
+    {
+        g_string_append(css, fallback);
+        return;
+    }
+
+    for (i = 0; i < (len - 1) / 2; i++)
+    {
+        gint high = g_ascii_xdigit_value(color[1 + 2 * i]);
+        gint low = g_ascii_xdigit_value(color[2 + 2 * i]);
+        if (high < 0 || low < 0)
+        {
+            g_string_append(css, fallback);
+            return;
+        }
+        channels[i] = high * 16 + low;
+    }
+
+    // the alpha is formatted independently of the locale
+    gchar alpha[G_ASCII_DTOSTR_BUF_SIZE];
+    g_ascii_formatd(alpha, sizeof(alpha), "%.3f", channels[3] / 255.0);
+    g_string_append_printf(css, "rgba(%u,%u,%u,%s)",
+            channels[0], channels[1], channels[2], alpha);
+}
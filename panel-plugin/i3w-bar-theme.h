@@ -0,0 +1,32 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_BAR_THEME_H__
+#define __I3W_BAR_THEME_H__
+
+#include <glib.h>
+
+/*
+ * The stylesheet of the workspace buttons derived from the colors block of
+ * the i3 bar, so the plugin looks like i3bar without copying its colors.
+ */
+
+gchar *
+i3w_bar_theme_css(GHashTable *colors);
+
+#endif /* !__I3W_BAR_THEME_H__ */
@@ -0,0 +1,489 @@
+/*  xfce4-netspeed-plugin
+ *
+ *  Copyright (c) 2011 Calin Crisan <ccrisan@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#include <gtk/gtk.h>
+#include <glib/gprintf.h>
+#include <libxfce4util/libxfce4util.h>
+#include <libxfce4ui/libxfce4ui.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "i3w-config-dialog.h"
+
+// the functions of the plugin, which is not linked to the dialog
+static const i3wConfigDialogHost *host;
+
+typedef struct {
+    i3WorkspacesConfig *config;
+    XfcePanelPlugin *plugin;
+    ConfigChangedCallback cb;
+    gpointer cb_data;
+} ConfigDialogClosedParam;
+
+void
+add_color_picker(i3WorkspacesConfig *config, GtkWidget *vbox, char *text, GdkRGBA *color_setting);
+
+void
+use_css_changed(GtkStack *stack, GParamSpec *pspec, i3WorkspacesConfig *config);
+void
+use_bar_colors_changed(GtkWidget *button, i3WorkspacesConfig *config);
+void
+color_changed(GtkWidget *button, GdkRGBA *color_setting);
+void
+css_changed(GtkTextBuffer *buffer, i3WorkspacesConfig *config);
+void
+strip_workspace_numbers_changed(GtkWidget *button, i3WorkspacesConfig *config);
+void
+label_format_changed(GtkWidget *entry, i3WorkspacesConfig *config);
+void
+pinned_workspaces_changed(GtkWidget *entry, i3WorkspacesConfig *config);
+void
+show_app_icons_changed(GtkWidget *button, i3WorkspacesConfig *config);
+void
+show_thumbnails_changed(GtkWidget *button, i3WorkspacesConfig *config);
+void
+show_window_titles_changed(GtkWidget *button, i3WorkspacesConfig *config);
+void
+animate_urgent_changed(GtkWidget *button, i3WorkspacesConfig *config);
+void
+stable_layout_changed(GtkWidget *button, i3WorkspacesConfig *config);
+void
+ingest_thread_changed(GtkWidget *button, i3WorkspacesConfig *config);
+void
+shared_helper_changed(GtkWidget *button, i3WorkspacesConfig *config);
+void
+latency_probe_interval_changed(GtkSpinButton *button, i3WorkspacesConfig *config);
+void
+auto_detect_outputs_changed(GtkWidget *button, i3WorkspacesConfig *config);
+void
+output_changed(GtkWidget *entry, i3WorkspacesConfig *config);
+
+gboolean
+diagnostics_refresh(GtkTextView *view);
+void
+diagnostics_destroyed(GtkWidget *view, gpointer source);
+
+void
+config_dialog_closed(GtkWidget *dialog, int response, ConfigDialogClosedParam *param);
+
+/* Function Implementations */
+
+void
+add_color_picker(i3WorkspacesConfig *config, GtkWidget *vbox, char *text, GdkRGBA *color_setting) {
+    GtkWidget *hbox, *button, *label;
+
+    /* focused color */
+    hbox = gtk_box_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(vbox), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    label = gtk_label_new(_(text));
+    gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+
+    button = gtk_color_button_new_with_rgba(color_setting);
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+
+    g_signal_connect(G_OBJECT(button), "color-set", G_CALLBACK(color_changed), color_setting);
+}
+
+void
+i3w_config_dialog_show(const i3wConfigDialogHost *dialog_host,
+        i3WorkspacesConfig *config, XfcePanelPlugin *plugin,
+        ConfigChangedCallback cb, gpointer cb_data)
+{
+    GtkWidget *dialog, *dialog_content, *hbox, *vbox, *view, *button, *label, *stack, *stack_switcher;
+    GtkTextBuffer *buffer;
+
+    host = dialog_host;
+
+    xfce_panel_plugin_block_menu(plugin);
+
+    dialog = xfce_titled_dialog_new_with_mixed_buttons(_("i3 Workspaces Plugin"),
+      GTK_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET(plugin))),
+      GTK_DIALOG_DESTROY_WITH_PARENT,
+      "window-close", "_Close",
+      GTK_RESPONSE_OK,
+      NULL);
+    xfce_titled_dialog_set_subtitle(XFCE_TITLED_DIALOG(dialog), _("Configuration"));
+
+    gtk_window_set_position(GTK_WINDOW(dialog), GTK_WIN_POS_CENTER);
+    gtk_window_set_keep_above(GTK_WINDOW(dialog), TRUE);
+    gtk_window_stick(GTK_WINDOW(dialog));
+
+    dialog_content = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+
+    /* color buttons or CSS */
+    stack = gtk_stack_new();
+
+    /* color buttons */
+    vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 3);
+    add_color_picker(config, vbox, "Normal Workspace Color:", &config->normal_color);
+    add_color_picker(config, vbox, "Focused Workspace Color:", &config->focused_color);
+    add_color_picker(config, vbox, "Urgent Workspace Color:", &config->urgent_color);
+    add_color_picker(config, vbox, "Unfocused Visible Workspace Color:", &config->visible_color);
+    add_color_picker(config, vbox, "Binding Mode Color:", &config->mode_color);
+
+    /* bar colors */
+    hbox = gtk_box_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(vbox), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_check_button_new_with_mnemonic(_("Use the colors of the i3 bar"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->use_bar_colors == TRUE);
+    gtk_widget_set_tooltip_text(button,
+            _("Take the workspace and binding mode colors from the colors block "
+              "of the first bar in the i3 config instead."));
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(use_bar_colors_changed), config);
+    gtk_stack_add_titled(GTK_STACK(stack), vbox, "buttons", "Color Pickers");
+    gtk_widget_set_visible(vbox, TRUE);
+
+    /* CSS */
+    hbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 3);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    view = gtk_text_view_new();
+    buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW (view));
+    gtk_text_buffer_set_text(buffer, config->css, -1);
+    gtk_box_pack_start(GTK_BOX(hbox), view, FALSE, FALSE, 0);
+    gtk_stack_add_titled(GTK_STACK(stack), hbox, "css", "Raw CSS");
+    g_signal_connect(G_OBJECT(buffer), "changed", G_CALLBACK(css_changed), config);
+
+    stack_switcher = gtk_stack_switcher_new();
+    gtk_stack_switcher_set_stack(GTK_STACK_SWITCHER(stack_switcher), GTK_STACK(stack));
+    gtk_box_pack_start(GTK_BOX(dialog_content), stack_switcher, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(dialog_content), stack, FALSE, FALSE, 0);
+    gtk_widget_set_visible(hbox, TRUE);
+    gtk_stack_set_visible_child_name(GTK_STACK(stack), config->use_css ? "css" : "buttons");
+    g_signal_connect(G_OBJECT(stack), "notify::visible-child", G_CALLBACK(use_css_changed), config);
+
+
+    /* strip workspace numbers */
+    hbox = gtk_box_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_content), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_check_button_new_with_mnemonic(_("Strip Workspace Numbers"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->strip_workspace_numbers == TRUE);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(strip_workspace_numbers_changed), config);
+
+    /* label format */
+    hbox = gtk_box_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_content), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    label = gtk_label_new(_("Label format:"));
+    gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+
+    button = gtk_entry_new();
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_entry_set_text(GTK_ENTRY(button), config->label_format);
+    gtk_widget_set_tooltip_text(button,
+            _("Placeholders: {num} {name} {short_name} {output} {windows}. "
+              "Pango markup is allowed. Leave empty for the default label."));
+    g_signal_connect(G_OBJECT(button), "changed", G_CALLBACK(label_format_changed), config);
+
+    /* pinned workspaces */
+    hbox = gtk_box_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_content), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    label = gtk_label_new(_("Pinned workspaces:"));
+    gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+
+    button = gtk_entry_new();
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_entry_set_text(GTK_ENTRY(button), config->pinned_workspaces);
+    gtk_widget_set_tooltip_text(button,
+            _("Workspaces always shown, even when empty, e.g. 1-10 or "
+              "names separated by commas."));
+    g_signal_connect(G_OBJECT(button), "changed", G_CALLBACK(pinned_workspaces_changed), config);
+
+    /* application icons */
+    hbox = gtk_box_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_content), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_check_button_new_with_mnemonic(_("Show application icons"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->show_app_icons == TRUE);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(show_app_icons_changed), config);
+
+    /* show workspace thumbnails on hover */
+    hbox = gtk_box_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_content), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_check_button_new_with_mnemonic(_("Show workspace thumbnails on hover"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->show_thumbnails == TRUE);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(show_thumbnails_changed), config);
+
+    /* list the window titles in the tooltips */
+    hbox = gtk_box_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_content), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_check_button_new_with_mnemonic(_("List the window titles in the tooltips"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->show_window_titles == TRUE);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(show_window_titles_changed), config);
+
+    /* pulse urgent workspace buttons */
+    hbox = gtk_box_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_content), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_check_button_new_with_mnemonic(_("Pulse urgent workspace buttons"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->animate_urgent == TRUE);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(animate_urgent_changed), config);
+
+    /* keep the button _widths stable */
+    hbox = gtk_box_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_content), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_check_button_new_with_mnemonic(_("Keep the button _widths stable"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->stable_layout == TRUE);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(stable_layout_changed), config);
+
+    /* decode i3 events on a separate thread */
+    hbox = gtk_box_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_content), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_check_button_new_with_mnemonic(_("Decode i3 events on a separate thread"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->ingest_thread == TRUE);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(ingest_thread_changed), config);
+
+    /* share one i3 connection between all panels */
+    hbox = gtk_box_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_content), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_check_button_new_with_mnemonic(_("Share one i3 connection between all panels"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->shared_helper == TRUE);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(shared_helper_changed), config);
+
+    /* latency probe */
+    hbox = gtk_box_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_content), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    label = gtk_label_new(_("Probe the i3 latency every (seconds, 0 to disable):"));
+    gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+
+    button = gtk_spin_button_new_with_range(0, 3600, 1);
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(button), config->latency_probe_interval);
+    g_signal_connect(G_OBJECT(button), "value-changed", G_CALLBACK(latency_probe_interval_changed), config);
+
+    /* auto detect output */
+    hbox = gtk_box_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_content), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    button = gtk_check_button_new_with_mnemonic(_("Auto detect outputs"));
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), config->auto_detect_outputs == TRUE);
+    g_signal_connect(G_OBJECT(button), "toggled", G_CALLBACK(auto_detect_outputs_changed), config);
+
+    /* output */
+    hbox = gtk_box_new(FALSE, 3);
+    gtk_container_add(GTK_CONTAINER(dialog_content), hbox);
+    gtk_container_set_border_width(GTK_CONTAINER(hbox), 3);
+
+    label = gtk_label_new(_("Output:"));
+    gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+
+    button = gtk_entry_new();
+    gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+    gtk_entry_set_text(GTK_ENTRY(button), config->output);
+    g_signal_connect(G_OBJECT(button), "changed", G_CALLBACK(output_changed), config);
+
+    /* diagnostics */
+    button = gtk_expander_new(_("Diagnostics"));
+    gtk_container_add(GTK_CONTAINER(dialog_content), button);
+    gtk_container_set_border_width(GTK_CONTAINER(button), 3);
+
+    view = gtk_text_view_new();
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(view), FALSE);
+    gtk_text_view_set_cursor_visible(GTK_TEXT_VIEW(view), FALSE);
+    gtk_text_view_set_monospace(GTK_TEXT_VIEW(view), TRUE);
+    gtk_container_add(GTK_CONTAINER(button), view);
+
+    diagnostics_refresh(GTK_TEXT_VIEW(view));
+    guint source = g_timeout_add_seconds(1, (GSourceFunc) diagnostics_refresh, view);
+    g_signal_connect(G_OBJECT(view), "destroy", G_CALLBACK(diagnostics_destroyed),
+            GUINT_TO_POINTER(source));
+
+    /* close event */
+    ConfigDialogClosedParam *param = g_new(ConfigDialogClosedParam, 1);
+    param->plugin = plugin;
+    param->config = config;
+    param->cb = cb;
+    param->cb_data = cb_data;
+    g_signal_connect(G_OBJECT(dialog), "response", G_CALLBACK(config_dialog_closed), param);
+
+    gtk_widget_show_all(dialog);
+}
+
+void
+use_css_changed(GtkStack *stack, GParamSpec *pspec, i3WorkspacesConfig *config) {
+    const gchar *visible_child = gtk_stack_get_visible_child_name(stack);
+    config->use_css = !g_strcmp0(visible_child, "css");
+}
+
+void
+use_bar_colors_changed(GtkWidget *button, i3WorkspacesConfig *config)
+{
+    config->use_bar_colors = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+}
+
+void
+css_changed(GtkTextBuffer *buffer, i3WorkspacesConfig *config)
+{
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds(buffer, &start, &end);
+    g_free(config->css);
+    config->css = gtk_text_buffer_get_text(buffer, &start, &end, FALSE);
+}
+
+void
+strip_workspace_numbers_changed(GtkWidget *button, i3WorkspacesConfig *config)
+{
+    config->strip_workspace_numbers = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+}
+
+void
+label_format_changed(GtkWidget *entry, i3WorkspacesConfig *config)
+{
+    g_free(config->label_format);
+    config->label_format = g_strdup(gtk_entry_get_text(GTK_ENTRY(entry)));
+}
+
+void
+pinned_workspaces_changed(GtkWidget *entry, i3WorkspacesConfig *config)
+{
+    g_free(config->pinned_workspaces);
+    config->pinned_workspaces = g_strdup(gtk_entry_get_text(GTK_ENTRY(entry)));
+}
+
+void
+show_app_icons_changed(GtkWidget *button, i3WorkspacesConfig *config)
+{
+    config->show_app_icons = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+}
+
+void
+show_thumbnails_changed(GtkWidget *button, i3WorkspacesConfig *config)
+{
+    config->show_thumbnails = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+}
+
+void
+show_window_titles_changed(GtkWidget *button, i3WorkspacesConfig *config)
+{
+    config->show_window_titles = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+}
+
+void
+animate_urgent_changed(GtkWidget *button, i3WorkspacesConfig *config)
+{
+    config->animate_urgent = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+}
+
+void
+stable_layout_changed(GtkWidget *button, i3WorkspacesConfig *config)
+{
+    config->stable_layout = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+}
+
+void
+ingest_thread_changed(GtkWidget *button, i3WorkspacesConfig *config)
+{
+    config->ingest_thread = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+}
+
+void
+shared_helper_changed(GtkWidget *button, i3WorkspacesConfig *config)
+{
+    config->shared_helper = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+}
+
+void
+latency_probe_interval_changed(GtkSpinButton *button, i3WorkspacesConfig *config)
+{
+    config->latency_probe_interval = gtk_spin_button_get_value_as_int(button);
+}
+
+void
+auto_detect_outputs_changed(GtkWidget *button, i3WorkspacesConfig *config)
+{
+    config->auto_detect_outputs = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+}
+
+void
+output_changed(GtkWidget *entry, i3WorkspacesConfig *config)
+{
+    g_free(config->output);
+    config->output = g_strdup(gtk_entry_get_text(GTK_ENTRY(entry)));
+}
+
+void
+color_changed(GtkWidget *button, GdkRGBA *color_setting)
+{
+    gtk_color_chooser_get_rgba(GTK_COLOR_CHOOSER(button), color_setting);
+}
+
+gboolean
+diagnostics_refresh(GtkTextView *view)
+{
+    gchar *text = host->stats_format();
+    gtk_text_buffer_set_text(gtk_text_view_get_buffer(view), text, -1);
+    g_free(text);
+
+    return G_SOURCE_CONTINUE;
+}
+
+void
+diagnostics_destroyed(GtkWidget *view, gpointer source)
+{
+    g_source_remove(GPOINTER_TO_UINT(source));
+}
+
+void
+config_dialog_closed(GtkWidget *dialog, int response, ConfigDialogClosedParam *param)
+{
+    xfce_panel_plugin_unblock_menu(param->plugin);
+
+    gtk_widget_destroy(dialog);
+
+    host->config_save(param->config, param->plugin);
+
+    if (param->cb) param->cb(param->cb_data);
+
+    g_free(param);
+}
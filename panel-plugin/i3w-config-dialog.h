@@ -0,0 +1,47 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_CONFIG_DIALOG_H__
+#define __I3W_CONFIG_DIALOG_H__
+
+#include "i3w-config.h"
+
+/*
+ * The configuration dialog is a separate module, only loaded when opened.
+ * It cannot call into the plugin library, which the panel opens with local
+ * symbols, so the plugin passes the functions the dialog needs.
+ */
+
+typedef struct
+{
+    gboolean (*config_save) (i3WorkspacesConfig *config, XfcePanelPlugin *plugin);
+    gchar *(*stats_format) (void);
+} i3wConfigDialogHost;
+
+#define I3W_CONFIG_DIALOG_SYMBOL "i3w_config_dialog_show"
+
+typedef void (*i3wConfigDialogShow) (const i3wConfigDialogHost *host,
+        i3WorkspacesConfig *config, XfcePanelPlugin *plugin,
+        ConfigChangedCallback cb, gpointer cb_data);
+
+void
+i3w_config_dialog_show(const i3wConfigDialogHost *host,
+        i3WorkspacesConfig *config, XfcePanelPlugin *plugin,
+        ConfigChangedCallback cb, gpointer cb_data);
+
+#endif /* !__I3W_CONFIG_DIALOG_H__ */
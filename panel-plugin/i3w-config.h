@@ -24,6 +24,7 @@
 typedef struct
 {
     gboolean use_css;
+    gboolean use_bar_colors;
     GdkRGBA normal_color;
     GdkRGBA focused_color;
     GdkRGBA visible_color;
@@ -31,6 +32,16 @@ typedef struct
     GdkRGBA mode_color;
     gchar *css;
     gboolean strip_workspace_numbers;
+    gchar *label_format;
+    gchar *pinned_workspaces;
+    gboolean show_app_icons;
+    gboolean show_thumbnails;
+    gboolean show_window_titles;
+    gboolean animate_urgent;
+    gboolean stable_layout;
+    gboolean ingest_thread;
+    gboolean shared_helper;
+    guint latency_probe_interval;
     gboolean auto_detect_outputs;
     gchar *output;
 }
@@ -0,0 +1,111 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+
+#include "i3w-css.h"
+
+// stylesheet => GtkCssProvider *, the entries are weak and go away with the
+// last reference to their provider
+static GHashTable *css_providers = NULL;
+
+/*
+ * Prototypes
+ */
+static void
+on_provider_finalized(gpointer css, GObject *provider);
+
+/*
+ * Implementations of public functions
+ */
+
+/**
+ * i3w_css_provider_get:
+ * @css: the stylesheet
+ *
+ * Get the provider of the stylesheet, shared with every other instance
+ * using the same stylesheet.
+ *
+ * Returns: a new reference to the provider, unref it when done.
+ */
+GtkCssProvider *
+i3w_css_provider_get(const gchar *css)
+{
+    if (!css_providers)
+        css_providers = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    GtkCssProvider *provider = g_hash_table_lookup(css_providers, css);
+    if (provider)
+        return g_object_ref(provider);
+
+    provider = gtk_css_provider_new();
+    gtk_css_provider_load_from_data(provider, css, -1, NULL);
+
+    gchar *key = g_strdup(css);
+    g_hash_table_insert(css_providers, key, provider);
+    g_object_weak_ref(G_OBJECT(provider), on_provider_finalized, key);
+
+    return provider;
+}
+
+/**
+ * i3w_css_apply:
+ * @widget: the top of the widget tree
+ * @old: the provider to remove, or NULL
+ * @provider: the provider to add, or NULL
+ *
+ * Replace the provider on the style contexts of the widget and all of its
+ * descendants. Only the contexts of the tree are invalidated.
+ */
+void
+i3w_css_apply(GtkWidget *widget, GtkCssProvider *old, GtkCssProvider *provider)
+{
+    GtkStyleContext *context = gtk_widget_get_style_context(widget);
+
+    if (old)
+        gtk_style_context_remove_provider(context, GTK_STYLE_PROVIDER(old));
+    if (provider)
+        gtk_style_context_add_provider(context, GTK_STYLE_PROVIDER(provider),
+                GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+
+    if (GTK_IS_CONTAINER(widget))
+    {
+        GList *children = gtk_container_get_children(GTK_CONTAINER(widget));
+        GList *child;
+        for (child = children; child != NULL; child = child->next)
+            i3w_css_apply(GTK_WIDGET(child->data), old, provider);
+        g_list_free(children);
+    }
+}
+
+/*
+ * Implementations of private functions
+ */
+
+/**
+ * on_provider_finalized:
+ * @css: the stylesheet of the provider
+ * @provider: the finalized provider
+ *
+ * The last instance using the stylesheet dropped it, forget the provider.
+ */
+static void
+on_provider_finalized(gpointer css, GObject *provider)
+{
+    g_hash_table_remove(css_providers, css);
+}
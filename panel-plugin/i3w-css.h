@@ -0,0 +1,37 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_CSS_H__
+#define __I3W_CSS_H__
+
+#include <gtk/gtk.h>
+
+/*
+ * CSS providers shared by all the plugin instances of the process, keyed by
+ * the stylesheet. They are attached to the style contexts of the plugin
+ * widgets only, never to the screen, so the other widgets of the panel are
+ * not affected by the plugin style or restyled when it changes.
+ */
+
+GtkCssProvider *
+i3w_css_provider_get(const gchar *css);
+
+void
+i3w_css_apply(GtkWidget *widget, GtkCssProvider *old, GtkCssProvider *provider);
+
+#endif /* !__I3W_CSS_H__ */
@@ -0,0 +1,218 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The workspace helper: keeps a single i3 subscription for all the plugin
+ * instances of the session and publishes the workspace model into shared
+ * memory, see i3w-shm.h. Started by the plugin when it is not running yet,
+ * exits together with i3.
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include <gio/gio.h>
+#include <json-glib/json-glib.h>
+
+#include "i3w-ipc-socket.h"
+#include "i3w-shm.h"
+
+#define SUBSCRIPTION "[\"workspace\",\"output\",\"mode\",\"shutdown\"]"
+
+/*
+ * Prototypes
+ */
+static gboolean
+refresh_model(gint fd, i3wShmModel *model, GError **err);
+static gboolean
+handle_event(guint32 type, const gchar *payload, i3wShmModel *model);
+
+int
+main(int argc, char **argv)
+{
+    GError *err = NULL;
+    i3wShmModel model;
+    gint sub_fd = -1, cmd_fd = -1;
+    gint status = 1;
+
+    gchar *path = argc > 1 ? g_strdup(argv[1]) : i3w_ipc_socket_path();
+    if (!path)
+    {
+        g_printerr("Cannot find the i3 socket\n");
+        return 1;
+    }
+
+    gchar *name = i3w_shm_name(path);
+    i3wShm *shm = i3w_shm_create(name, &err);
+    g_free(name);
+    if (!shm)
+    {
+        // another helper already serves this session
+        status = g_error_matches(err, G_IO_ERROR, G_IO_ERROR_EXISTS) ? 0 : 1;
+        if (status)
+            g_printerr("%s\n", err->message);
+        g_error_free(err);
+        g_free(path);
+        return status;
+    }
+
+    sub_fd = i3w_ipc_connect(path, &err);
+    if (sub_fd >= 0)
+        cmd_fd = i3w_ipc_connect(path, &err);
+    g_free(path);
+
+    if (cmd_fd < 0 || !i3w_ipc_send(sub_fd, I3W_IPC_SUBSCRIBE, SUBSCRIPTION, &err))
+        goto out;
+
+    memset(&model, 0, sizeof(model));
+    g_strlcpy(model.mode, "default", sizeof(model.mode));
+    if (!refresh_model(cmd_fd, &model, &err))
+        goto out;
+    i3w_shm_publish(shm, &model);
+
+    for (;;)
+    {
+        gboolean dirty = FALSE;
+        gboolean publish = FALSE;
+        guint32 type;
+
+        // handle a burst of events with a single refresh
+        do
+        {
+            gchar *payload = i3w_ipc_recv(sub_fd, &type, &err);
+            if (!payload)
+                goto out;
+
+            if (type == (I3W_IPC_EVENT_MASK | I3W_IPC_EVENT_SHUTDOWN))
+            {
+                g_free(payload);
+                status = 0;
+                goto out;
+            }
+
+            if (handle_event(type, payload, &model))
+                publish = TRUE;
+            else if (type & I3W_IPC_EVENT_MASK)
+                dirty = TRUE;
+            g_free(payload);
+        }
+        while (i3w_ipc_pending(sub_fd));
+
+        if (dirty)
+        {
+            if (!refresh_model(cmd_fd, &model, &err))
+                goto out;
+            publish = TRUE;
+        }
+
+        if (publish)
+            i3w_shm_publish(shm, &model);
+    }
+
+out:
+    if (err)
+    {
+        g_printerr("%s\n", err->message);
+        g_error_free(err);
+    }
+    if (sub_fd >= 0)
+        close(sub_fd);
+    if (cmd_fd >= 0)
+        close(cmd_fd);
+    i3w_shm_destroy(shm);
+
+    return status;
+}
+
+/**
+ * refresh_model:
+ * @fd: the command connection
+ * @model: the model to fill in, the binding mode is left alone
+ * @err: the error object
+ *
+ * Query the workspaces and the outputs. Workspaces beyond
+ * I3W_SHM_WORKSPACES_MAX or the name area of the model are left out, output
+ * names are truncated.
+ *
+ * Returns: FALSE on error
+ */
+static gboolean
+refresh_model(gint fd, i3wShmModel *model, GError **err)
+{
+    JsonParser *parser = json_parser_new();
+    JsonArray *array;
+    guint i;
+
+    array = i3w_ipc_query_array(fd, I3W_IPC_GET_WORKSPACES, parser, err);
+    if (!array)
+    {
+        g_object_unref(parser);
+        return FALSE;
+    }
+
+    i3w_shm_model_load_workspaces(model, array);
+
+    array = i3w_ipc_query_array(fd, I3W_IPC_GET_OUTPUTS, parser, err);
+    if (!array)
+    {
+        g_object_unref(parser);
+        return FALSE;
+    }
+
+    model->n_outputs = 0;
+    for (i = 0; i < json_array_get_length(array) && model->n_outputs < I3W_SHM_OUTPUTS_MAX; i++)
+    {
+        JsonObject *object = json_array_get_object_element(array, i);
+        if (json_object_get_boolean_member(object, "active"))
+            g_strlcpy(model->outputs[model->n_outputs++], i3w_ipc_json_string(object, "name"),
+                    I3W_SHM_OUTPUT_MAX);
+    }
+
+    g_object_unref(parser);
+
+    return TRUE;
+}
+
+/**
+ * handle_event:
+ * @type: the message type
+ * @payload: the JSON payload
+ * @model: the model
+ *
+ * Apply the events carrying all the information needed, that is the binding
+ * mode changes.
+ *
+ * Returns: TRUE if the event was applied to the model
+ */
+static gboolean
+handle_event(guint32 type, const gchar *payload, i3wShmModel *model)
+{
+    if (type != (I3W_IPC_EVENT_MASK | I3W_IPC_EVENT_MODE))
+        return FALSE;
+
+    JsonParser *parser = json_parser_new();
+    if (json_parser_load_from_data(parser, payload, -1, NULL) &&
+        JSON_NODE_HOLDS_OBJECT(json_parser_get_root(parser)))
+    {
+        JsonObject *root = json_node_get_object(json_parser_get_root(parser));
+        g_strlcpy(model->mode, i3w_ipc_json_string(root, "change"), sizeof(model->mode));
+    }
+    g_object_unref(parser);
+
+    return TRUE;
+}
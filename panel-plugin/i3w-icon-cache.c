@@ -0,0 +1,227 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+
+#include "i3w-icon-cache.h"
+
+#define FALLBACK_ICON_NAME "application-x-executable"
+
+typedef struct
+{
+    gchar *key;
+    GdkPixbuf *pixbuf;
+    // GtkImage * waiting for the icon to be loaded
+    GSList *waiters;
+    gboolean loading;
+} i3wIconEntry;
+
+// "size:class" => i3wIconEntry *
+static GHashTable *icon_cache = NULL;
+
+/*
+ * Prototypes
+ */
+static void
+destroy_entry(i3wIconEntry *entry);
+static void
+on_icon_theme_changed(GtkIconTheme *theme, gpointer data);
+static GtkIconInfo *
+lookup_icon(GtkIconTheme *theme, const gchar *app, gint size);
+static void
+on_icon_loaded(GObject *source, GAsyncResult *result, gpointer data);
+static void
+flush_waiters(i3wIconEntry *entry);
+
+/*
+ * Implementations of public functions
+ */
+
+/**
+ * i3w_icon_cache_set_image:
+ * @image: the image to show the icon in
+ * @app: the window class of the application
+ * @size: the icon size in pixels
+ *
+ * Show the icon of the application in the image. If the icon is not loaded
+ * yet, the image is filled in once the load finishes.
+ */
+void
+i3w_icon_cache_set_image(GtkImage *image, const gchar *app, gint size)
+{
+    if (!icon_cache)
+    {
+        icon_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+                NULL, (GDestroyNotify) destroy_entry);
+        g_signal_connect(gtk_icon_theme_get_default(), "changed",
+                G_CALLBACK(on_icon_theme_changed), NULL);
+    }
+
+    gchar *key = g_strdup_printf("%d:%s", size, app);
+    i3wIconEntry *entry = g_hash_table_lookup(icon_cache, key);
+
+    if (entry)
+    {
+        g_free(key);
+
+        if (entry->loading)
+            entry->waiters = g_slist_prepend(entry->waiters, g_object_ref(image));
+        else if (entry->pixbuf)
+            gtk_image_set_from_pixbuf(image, entry->pixbuf);
+        return;
+    }
+
+    entry = g_new0(i3wIconEntry, 1);
+    entry->key = key;
+    g_hash_table_insert(icon_cache, entry->key, entry);
+
+    GtkIconInfo *info = lookup_icon(gtk_icon_theme_get_default(), app, size);
+    if (!info)
+        return;
+
+    entry->loading = TRUE;
+    entry->waiters = g_slist_prepend(entry->waiters, g_object_ref(image));
+    gtk_icon_info_load_icon_async(info, NULL, on_icon_loaded, g_strdup(entry->key));
+    g_object_unref(info);
+}
+
+/*
+ * Implementations of private functions
+ */
+
+/**
+ * destroy_entry:
+ * @entry: the cache entry
+ *
+ * Free the cache entry. Loads still in flight find their entry gone and
+ * drop their result.
+ */
+static void
+destroy_entry(i3wIconEntry *entry)
+{
+    g_slist_free_full(entry->waiters, g_object_unref);
+    if (entry->pixbuf)
+        g_object_unref(entry->pixbuf);
+    g_free(entry->key);
+    g_free(entry);
+}
+
+/**
+ * on_icon_theme_changed:
+ * @theme: the icon theme
+ * @data: unused
+ *
+ * Drop all the cached icons, they are reloaded with the next refresh.
+ */
+static void
+on_icon_theme_changed(GtkIconTheme *theme, gpointer data)
+{
+    g_hash_table_remove_all(icon_cache);
+}
+
+/**
+ * lookup_icon:
+ * @theme: the icon theme
+ * @app: the window class
+ * @size: the icon size in pixels
+ *
+ * Find the icon of the application by its window class, trying the lower
+ * case class and finally a generic icon. Looking up the theme's index is
+ * cheap, the image itself is not loaded here.
+ *
+ * Returns: the icon info or NULL, unref with g_object_unref()
+ */
+static GtkIconInfo *
+lookup_icon(GtkIconTheme *theme, const gchar *app, gint size)
+{
+    GtkIconInfo *info = gtk_icon_theme_lookup_icon(theme, app, size,
+            GTK_ICON_LOOKUP_FORCE_SIZE);
+
+    if (!info)
+    {
+        gchar *lower = g_ascii_strdown(app, -1);
+        info = gtk_icon_theme_lookup_icon(theme, lower, size,
+                GTK_ICON_LOOKUP_FORCE_SIZE);
+        g_free(lower);
+    }
+
+    if (!info)
+        info = gtk_icon_theme_lookup_icon(theme, FALLBACK_ICON_NAME, size,
+                GTK_ICON_LOOKUP_FORCE_SIZE);
+
+    return info;
+}
+
+/**
+ * on_icon_loaded:
+ * @source: the icon info
+ * @result: the result of the load
+ * @data: the cache key, owned by the callback
+ *
+ * Store the loaded icon and hand it to the images waiting for it.
+ */
+static void
+on_icon_loaded(GObject *source, GAsyncResult *result, gpointer data)
+{
+    gchar *key = (gchar *) data;
+    GError *err = NULL;
+
+    GdkPixbuf *pixbuf = gtk_icon_info_load_icon_finish(GTK_ICON_INFO(source), result, &err);
+    if (err != NULL)
+    {
+        fprintf(stderr, "Failed to load icon %s: %s\n", key, err->message);
+        g_error_free(err);
+    }
+
+    i3wIconEntry *entry = icon_cache ? g_hash_table_lookup(icon_cache, key) : NULL;
+    if (entry && entry->loading)
+    {
+        entry->pixbuf = pixbuf;
+        entry->loading = FALSE;
+        flush_waiters(entry);
+    }
+    else if (pixbuf)
+    {
+        g_object_unref(pixbuf);
+    }
+
+    g_free(key);
+}
+
+/**
+ * flush_waiters:
+ * @entry: the cache entry
+ *
+ * Set the icon on all the images still alive that asked for it.
+ */
+static void
+flush_waiters(i3wIconEntry *entry)
+{
+    GSList *witem;
+
+    for (witem = entry->waiters; witem != NULL; witem = witem->next)
+    {
+        GtkWidget *image = GTK_WIDGET(witem->data);
+        if (entry->pixbuf && !gtk_widget_in_destruction(image) &&
+            gtk_widget_get_parent(image))
+            gtk_image_set_from_pixbuf(GTK_IMAGE(image), entry->pixbuf);
+    }
+
+    g_slist_free_full(entry->waiters, g_object_unref);
+    entry->waiters = NULL;
+}
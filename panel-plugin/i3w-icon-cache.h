@@ -0,0 +1,33 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_ICON_CACHE_H__
+#define __I3W_ICON_CACHE_H__
+
+#include <gtk/gtk.h>
+
+/*
+ * Application icons shared by all the plugin instances of the process, keyed
+ * by window class and size. Icons are loaded asynchronously, every request
+ * for an icon still being loaded is served by the same load.
+ */
+
+void
+i3w_icon_cache_set_image(GtkImage *image, const gchar *app, gint size);
+
+#endif /* !__I3W_ICON_CACHE_H__ */
@@ -0,0 +1,430 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "i3w-ipc-ingest.h"
+#include "i3w-ipc-socket.h"
+#include "i3w-trace.h"
+
+#define RING_SIZE 256
+
+#define SUBSCRIPTION "[\"workspace\",\"output\",\"mode\"]"
+
+struct _i3w_ingest
+{
+    gint ref_count;
+
+    gint fd;
+    // GET_WORKSPACES is answered on a connection without subscriptions
+    gint cmd_fd;
+    GThread *thread;
+    gint stopping;
+
+    i3wIngestCallback callback;
+    gpointer data;
+
+    // head is only written by the thread, tail only by the main loop
+    i3wIngestRecord ring[RING_SIZE];
+    guint head;
+    guint tail;
+    gint overflow;
+    gint wakeup_pending;
+
+    // the latest model not taken by the main loop yet
+    i3wShmModel *workspaces;
+};
+
+/*
+ * Prototypes
+ */
+static void
+ingest_unref(i3wIngest *ingest);
+static gboolean
+ingest_unref_idle(gpointer data);
+static gpointer
+ingest_thread(gpointer data);
+static gboolean
+decode_event(guint32 type, const gchar *payload, i3wIngestRecord *record);
+static gboolean
+query_workspaces(i3wIngest *ingest);
+static void
+push_record(i3wIngest *ingest, const i3wIngestRecord *record);
+static gboolean
+drain_records(gpointer data);
+
+/*
+ * Implementations of public functions
+ */
+
+/**
+ * i3w_ingest_start:
+ * @socket_path: the i3 IPC socket path
+ * @callback: the record callback
+ * @data: the data to be passed to the callback function
+ * @err: the error object
+ *
+ * Subscribe to the workspace, output and mode events on a connection of its
+ * own, open the command connection and start the ingestion thread.
+ *
+ * Returns: the ingestion thread or NULL on error
+ */
+i3wIngest *
+i3w_ingest_start(const gchar *socket_path, i3wIngestCallback callback,
+        gpointer data, GError **err)
+{
+    gint fd = i3w_ipc_connect(socket_path, err);
+    if (fd < 0)
+        return NULL;
+
+    if (!i3w_ipc_send(fd, I3W_IPC_SUBSCRIBE, SUBSCRIPTION, err))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    gint cmd_fd = i3w_ipc_connect(socket_path, err);
+    if (cmd_fd < 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    i3wIngest *ingest = g_new0(i3wIngest, 1);
+    ingest->ref_count = 1;
+    ingest->fd = fd;
+    ingest->cmd_fd = cmd_fd;
+    ingest->callback = callback;
+    ingest->data = data;
+
+    // the thread holds a reference until its last wakeup has run
+    g_atomic_int_inc(&ingest->ref_count);
+    ingest->thread = g_thread_new("i3w-ingest", ingest_thread, ingest);
+
+    return ingest;
+}
+
+/**
+ * i3w_ingest_take_workspaces:
+ * @ingest: the ingestion thread
+ *
+ * Take the model queried after the last batch of workspace or output
+ * events, to be called from the main loop.
+ *
+ * Returns: the model or NULL if there is no new one since the last call,
+ * free with g_free()
+ */
+i3wShmModel *
+i3w_ingest_take_workspaces(i3wIngest *ingest)
+{
+    i3wShmModel *model;
+
+    do
+        model = g_atomic_pointer_get(&ingest->workspaces);
+    while (model && !g_atomic_pointer_compare_and_exchange(&ingest->workspaces, model, NULL));
+
+    return model;
+}
+
+/**
+ * i3w_ingest_stop:
+ * @ingest: the ingestion thread
+ *
+ * Stop the thread and drop the records not delivered yet.
+ */
+void
+i3w_ingest_stop(i3wIngest *ingest)
+{
+    g_atomic_int_set(&ingest->stopping, TRUE);
+
+    // wakes the thread from its blocking read
+    shutdown(ingest->fd, SHUT_RDWR);
+    shutdown(ingest->cmd_fd, SHUT_RDWR);
+    g_thread_join(ingest->thread);
+    close(ingest->fd);
+    close(ingest->cmd_fd);
+    g_free(ingest->workspaces);
+
+    ingest_unref(ingest);
+}
+
+/*
+ * Implementations of private functions
+ */
+
+/**
+ * ingest_unref:
+ * @ingest: the ingestion thread
+ *
+ * Drop a reference, pending wakeups hold one.
+ */
+static void
+ingest_unref(i3wIngest *ingest)
+{
+    if (g_atomic_int_dec_and_test(&ingest->ref_count))
+        g_free(ingest);
+}
+
+/**
+ * ingest_unref_idle:
+ * @data: the ingestion thread
+ *
+ * Drop the reference of the thread from the main loop.
+ *
+ * Returns: G_SOURCE_REMOVE
+ */
+static gboolean
+ingest_unref_idle(gpointer data)
+{
+    ingest_unref((i3wIngest *) data);
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * ingest_thread:
+ * @data: the ingestion thread
+ *
+ * Read and decode events until the connection is closed. The records of a
+ * burst of events are held back until the workspaces are queried, so the
+ * main loop never handles them with an older model.
+ *
+ * Returns: NULL
+ */
+static gpointer
+ingest_thread(gpointer data)
+{
+    i3wIngest *ingest = (i3wIngest *) data;
+    i3wIngestRecord batch[RING_SIZE];
+    i3wIngestRecord record;
+    guint32 type;
+    gchar *payload;
+    gboolean connected = TRUE;
+
+    while (connected)
+    {
+        gboolean dirty = FALSE;
+        guint n = 0, i;
+
+        do
+        {
+            payload = i3w_ipc_recv(ingest->fd, &type, NULL);
+            if (!payload)
+            {
+                connected = FALSE;
+                break;
+            }
+
+            gint64 trace = i3w_trace_begin();
+            gboolean decoded = decode_event(type, payload, &batch[n]);
+            i3w_trace_end("ipc_decode", trace, !decoded ? NULL :
+                    batch[n].change[0] ? batch[n].change : batch[n].name, -1);
+            g_free(payload);
+
+            if (decoded)
+            {
+                if (batch[n].kind != I3W_INGEST_MODE)
+                    dirty = TRUE;
+                n++;
+            }
+        }
+        while (n < RING_SIZE && i3w_ipc_pending(ingest->fd));
+
+        if (dirty && connected && !query_workspaces(ingest))
+            connected = FALSE;
+
+        for (i = 0; i < n; i++)
+            push_record(ingest, &batch[i]);
+    }
+
+    if (!g_atomic_int_get(&ingest->stopping))
+    {
+        memset(&record, 0, sizeof(record));
+        record.kind = I3W_INGEST_SHUTDOWN;
+        push_record(ingest, &record);
+    }
+
+    // the main loop's reference to the thread's wakeups
+    g_idle_add(ingest_unref_idle, ingest);
+
+    return NULL;
+}
+
+/**
+ * query_workspaces:
+ * @ingest: the ingestion thread
+ *
+ * Query the workspaces on the command connection and replace the model not
+ * taken by the main loop yet.
+ *
+ * Returns: FALSE if the command connection failed
+ */
+static gboolean
+query_workspaces(i3wIngest *ingest)
+{
+    gint64 trace = i3w_trace_begin();
+    JsonParser *parser = json_parser_new();
+    JsonArray *array = i3w_ipc_query_array(ingest->cmd_fd, I3W_IPC_GET_WORKSPACES, parser, NULL);
+
+    if (!array)
+    {
+        g_object_unref(parser);
+        i3w_trace_end("ipc_get_workspaces", trace, "failed", -1);
+        return FALSE;
+    }
+
+    i3wShmModel *model = g_new0(i3wShmModel, 1);
+    i3w_shm_model_load_workspaces(model, array);
+    g_object_unref(parser);
+
+    i3wShmModel *previous;
+    do
+        previous = g_atomic_pointer_get(&ingest->workspaces);
+    while (!g_atomic_pointer_compare_and_exchange(&ingest->workspaces, previous, model));
+    g_free(previous);
+
+    i3w_trace_end("ipc_get_workspaces", trace, NULL, model->n_workspaces);
+
+    return TRUE;
+}
+
+/**
+ * decode_event:
+ * @type: the message type
+ * @payload: the JSON payload
+ * @record: the record to fill in
+ *
+ * Returns: TRUE if the message is an event the main loop is interested in
+ */
+static gboolean
+decode_event(guint32 type, const gchar *payload, i3wIngestRecord *record)
+{
+    if (!(type & I3W_IPC_EVENT_MASK))
+        return FALSE;
+
+    memset(record, 0, sizeof(*record));
+    switch (type & ~I3W_IPC_EVENT_MASK)
+    {
+        case I3W_IPC_EVENT_WORKSPACE: record->kind = I3W_INGEST_WORKSPACE; break;
+        case I3W_IPC_EVENT_OUTPUT: record->kind = I3W_INGEST_OUTPUT; break;
+        case I3W_IPC_EVENT_MODE: record->kind = I3W_INGEST_MODE; break;
+        default: return FALSE;
+    }
+
+    JsonParser *parser = json_parser_new();
+    if (!json_parser_load_from_data(parser, payload, -1, NULL) ||
+        !JSON_NODE_HOLDS_OBJECT(json_parser_get_root(parser)))
+    {
+        g_object_unref(parser);
+        return FALSE;
+    }
+
+    JsonObject *root = json_node_get_object(json_parser_get_root(parser));
+    const gchar *change = i3w_ipc_json_string(root, "change");
+
+    if (record->kind == I3W_INGEST_MODE)
+    {
+        g_strlcpy(record->name, change, sizeof(record->name));
+    }
+    else
+    {
+        g_strlcpy(record->change, change, sizeof(record->change));
+
+        JsonNode *current = json_object_get_member(root, "current");
+        if (current && JSON_NODE_HOLDS_OBJECT(current))
+            g_strlcpy(record->name, i3w_ipc_json_string(json_node_get_object(current), "name"),
+                    sizeof(record->name));
+    }
+
+    g_object_unref(parser);
+
+    return TRUE;
+}
+
+/**
+ * push_record:
+ * @ingest: the ingestion thread
+ * @record: the record
+ *
+ * Append the record to the ring and wake the main loop unless a wakeup is
+ * already pending. When the ring is full the record is dropped and the
+ * overflow is reported instead.
+ */
+static void
+push_record(i3wIngest *ingest, const i3wIngestRecord *record)
+{
+    guint head = g_atomic_int_get(&ingest->head);
+    guint tail = g_atomic_int_get(&ingest->tail);
+
+    if (head - tail >= RING_SIZE)
+    {
+        g_atomic_int_set(&ingest->overflow, TRUE);
+    }
+    else
+    {
+        ingest->ring[head % RING_SIZE] = *record;
+        g_atomic_int_set(&ingest->head, head + 1);
+    }
+
+    if (g_atomic_int_compare_and_exchange(&ingest->wakeup_pending, FALSE, TRUE))
+    {
+        g_atomic_int_inc(&ingest->ref_count);
+        g_idle_add_full(G_PRIORITY_DEFAULT, drain_records, ingest,
+                (GDestroyNotify) ingest_unref);
+    }
+}
+
+/**
+ * drain_records:
+ * @data: the ingestion thread
+ *
+ * Deliver all the records in the ring to the callback.
+ *
+ * Returns: G_SOURCE_REMOVE
+ */
+static gboolean
+drain_records(gpointer data)
+{
+    i3wIngest *ingest = (i3wIngest *) data;
+
+    // records pushed from now on need a new wakeup
+    g_atomic_int_set(&ingest->wakeup_pending, FALSE);
+
+    if (g_atomic_int_get(&ingest->stopping))
+        return G_SOURCE_REMOVE;
+
+    guint head = g_atomic_int_get(&ingest->head);
+    guint tail = ingest->tail;
+
+    while (tail != head)
+    {
+        i3wIngestRecord record = ingest->ring[tail % RING_SIZE];
+        g_atomic_int_set(&ingest->tail, ++tail);
+        ingest->callback(&record, ingest->data);
+
+        // the callback may have stopped the ingestion
+        if (g_atomic_int_get(&ingest->stopping))
+            return G_SOURCE_REMOVE;
+    }
+
+    if (g_atomic_int_compare_and_exchange(&ingest->overflow, TRUE, FALSE))
+        ingest->callback(NULL, ingest->data);
+
+    return G_SOURCE_REMOVE;
+}
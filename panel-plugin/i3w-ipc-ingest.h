@@ -0,0 +1,73 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_IPC_INGEST_H__
+#define __I3W_IPC_INGEST_H__
+
+#include <glib.h>
+
+#include "i3w-shm.h"
+
+/*
+ * A thread owning an i3 event subscription. Events are read and decoded on
+ * the thread into fixed size records, which reach the main loop through a
+ * single-producer/single-consumer ring. The main loop is woken once per
+ * batch of records. After a batch with workspace or output events the
+ * thread queries the workspaces on a command connection of its own, the
+ * model is ready before the records of the batch are delivered.
+ */
+
+#define I3W_INGEST_CHANGE_MAX 16
+#define I3W_INGEST_NAME_MAX 128
+
+typedef enum
+{
+    I3W_INGEST_WORKSPACE,
+    I3W_INGEST_OUTPUT,
+    I3W_INGEST_MODE,
+    I3W_INGEST_SHUTDOWN
+} i3wIngestKind;
+
+typedef struct _i3w_ingest_record
+{
+    i3wIngestKind kind;
+    // the change of a workspace event
+    gchar change[I3W_INGEST_CHANGE_MAX];
+    // the workspace of a workspace event or the binding mode
+    gchar name[I3W_INGEST_NAME_MAX];
+} i3wIngestRecord;
+
+typedef struct _i3w_ingest i3wIngest;
+
+/*
+ * Called on the main loop for every record, or with NULL when records were
+ * lost because the ring was full.
+ */
+typedef void (*i3wIngestCallback) (const i3wIngestRecord *record, gpointer data);
+
+i3wIngest *
+i3w_ingest_start(const gchar *socket_path, i3wIngestCallback callback,
+        gpointer data, GError **err);
+
+i3wShmModel *
+i3w_ingest_take_workspaces(i3wIngest *ingest);
+
+void
+i3w_ingest_stop(i3wIngest *ingest);
+
+#endif /* !__I3W_IPC_INGEST_H__ */
@@ -0,0 +1,344 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <gio/gio.h>
+
+#include "i3w-ipc-socket.h"
+
+#define HEADER_SIZE (sizeof(I3W_IPC_MAGIC) - 1 + 2 * sizeof(guint32))
+// a get_tree reply of a large session stays well below this
+#define PAYLOAD_MAX (8 * 1024 * 1024)
+
+/*
+ * Prototypes
+ */
+static gboolean
+write_all(gint fd, const void *buf, gsize len, GError **err);
+static gboolean
+read_all(gint fd, void *buf, gsize len, GError **err);
+
+/*
+ * Implementations of public functions
+ */
+
+/**
+ * i3w_ipc_socket_path:
+ *
+ * Find the i3 IPC socket the same way i3ipc-glib does: I3SOCK first, then
+ * ask i3 itself.
+ *
+ * Returns: the socket path or NULL, free with g_free()
+ */
+gchar *
+i3w_ipc_socket_path(void)
+{
+    const gchar *env = g_getenv("I3SOCK");
+    gchar *out = NULL;
+
+    if (env && env[0])
+        return g_strdup(env);
+
+    if (!g_spawn_command_line_sync("i3 --get-socketpath", &out, NULL, NULL, NULL))
+        return NULL;
+
+    g_strstrip(out);
+    if (!out[0])
+    {
+        g_free(out);
+        return NULL;
+    }
+
+    return out;
+}
+
+/**
+ * i3w_ipc_connect:
+ * @path: the socket path
+ * @err: the error object
+ *
+ * Connect to the i3 IPC socket.
+ *
+ * Returns: the socket, or -1 on error
+ */
+gint
+i3w_ipc_connect(const gchar *path, GError **err)
+{
+    struct sockaddr_un addr;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        g_set_error(err, G_IO_ERROR, G_IO_ERROR_FAILED,
+                "Socket path too long: %s", path);
+        return -1;
+    }
+
+    gint fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        g_set_error(err, G_IO_ERROR, g_io_error_from_errno(errno),
+                "Failed to create socket: %s", g_strerror(errno));
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+    {
+        g_set_error(err, G_IO_ERROR, g_io_error_from_errno(errno),
+                "Failed to connect to %s: %s", path, g_strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * i3w_ipc_send:
+ * @fd: the socket
+ * @type: the message type
+ * @payload: (nullable): the message payload
+ * @err: the error object
+ *
+ * Send a message to i3.
+ *
+ * Returns: TRUE on success
+ */
+gboolean
+i3w_ipc_send(gint fd, guint32 type, const gchar *payload, GError **err)
+{
+    guchar header[HEADER_SIZE];
+    guint32 len = payload ? strlen(payload) : 0;
+
+    memcpy(header, I3W_IPC_MAGIC, sizeof(I3W_IPC_MAGIC) - 1);
+    memcpy(header + sizeof(I3W_IPC_MAGIC) - 1, &len, sizeof(len));
+    memcpy(header + sizeof(I3W_IPC_MAGIC) - 1 + sizeof(len), &type, sizeof(type));
+
+    return write_all(fd, header, sizeof(header), err) &&
+        write_all(fd, payload, len, err);
+}
+
+/**
+ * i3w_ipc_recv:
+ * @fd: the socket
+ * @type: return location for the message type, events have
+ * I3W_IPC_EVENT_MASK set
+ * @err: the error object
+ *
+ * Receive the next message or event, blocking until it arrives. Messages
+ * longer than PAYLOAD_MAX are rejected, the stream cannot be trusted after
+ * them and the socket should be reconnected.
+ *
+ * Returns: the NUL terminated payload, or NULL on error or when the socket
+ * was closed. Free with g_free().
+ */
+gchar *
+i3w_ipc_recv(gint fd, guint32 *type, GError **err)
+{
+    guchar header[HEADER_SIZE];
+    guint32 len;
+
+    if (!read_all(fd, header, sizeof(header), err))
+        return NULL;
+
+    if (memcmp(header, I3W_IPC_MAGIC, sizeof(I3W_IPC_MAGIC) - 1) != 0)
+    {
+        g_set_error(err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Invalid i3 IPC header");
+        return NULL;
+    }
+
+    memcpy(&len, header + sizeof(I3W_IPC_MAGIC) - 1, sizeof(len));
+    memcpy(type, header + sizeof(I3W_IPC_MAGIC) - 1 + sizeof(len), sizeof(*type));
+
+    if (len > PAYLOAD_MAX)
+    {
+        g_set_error(err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                "Oversized i3 IPC message of %u bytes", len);
+        return NULL;
+    }
+
+    gchar *payload = g_malloc(len + 1);
+    if (!read_all(fd, payload, len, err))
+    {
+        g_free(payload);
+        return NULL;
+    }
+    payload[len] = 0;
+
+    return payload;
+}
+
+/**
+ * i3w_ipc_query_array:
+ * @fd: a command connection
+ * @type: the message type
+ * @parser: the parser, owns the result
+ * @err: the error object
+ *
+ * Send a query and parse the reply, skipping events.
+ *
+ * Returns: the JSON array replied or NULL on error
+ */
+JsonArray *
+i3w_ipc_query_array(gint fd, guint32 type, JsonParser *parser, GError **err)
+{
+    guint32 reply_type;
+    gchar *payload;
+
+    if (!i3w_ipc_send(fd, type, "", err))
+        return NULL;
+
+    do
+    {
+        payload = i3w_ipc_recv(fd, &reply_type, err);
+        if (!payload)
+            return NULL;
+        if (reply_type != type)
+            g_free(payload);
+    }
+    while (reply_type != type);
+
+    gboolean parsed = json_parser_load_from_data(parser, payload, -1, err);
+    g_free(payload);
+    if (!parsed)
+        return NULL;
+
+    JsonNode *root = json_parser_get_root(parser);
+    if (!JSON_NODE_HOLDS_ARRAY(root))
+    {
+        g_set_error(err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Unexpected reply from i3");
+        return NULL;
+    }
+
+    return json_node_get_array(root);
+}
+
+/**
+ * i3w_ipc_pending:
+ * @fd: the socket
+ *
+ * Returns: whether more messages can be read without blocking
+ */
+gboolean
+i3w_ipc_pending(gint fd)
+{
+    struct pollfd pfd = { fd, POLLIN, 0 };
+
+    return poll(&pfd, 1, 0) > 0;
+}
+
+/**
+ * i3w_ipc_json_string:
+ * @object: the JSON object
+ * @member: the member name
+ *
+ * Returns: the string value of the member, or "" if it is missing or not a
+ * string
+ */
+const gchar *
+i3w_ipc_json_string(JsonObject *object, const gchar *member)
+{
+    JsonNode *node = json_object_get_member(object, member);
+
+    if (!node || json_node_get_value_type(node) != G_TYPE_STRING)
+        return "";
+
+    return json_node_get_string(node);
+}
+
+/*
+ * Implementations of private functions
+ */
+
+/**
+ * write_all:
+ * @fd: the socket
+ * @buf: the data
+ * @len: the length of the data
+ * @err: the error object
+ *
+ * Returns: TRUE if all the data was written
+ */
+static gboolean
+write_all(gint fd, const void *buf, gsize len, GError **err)
+{
+    const guchar *p = buf;
+
+    while (len > 0)
+    {
+        gssize n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+        {
+            g_set_error(err, G_IO_ERROR, g_io_error_from_errno(errno),
+                    "Failed to write to i3: %s", g_strerror(errno));
+            return FALSE;
+        }
+        p += n;
+        len -= n;
+    }
+
+    return TRUE;
+}
+
+/**
+ * read_all:
+ * @fd: the socket
+ * @buf: the buffer
+ * @len: the number of bytes to read
+ * @err: the error object
+ *
+ * Returns: TRUE if all the data was read, FALSE on error or end of stream
+ */
+static gboolean
+read_all(gint fd, void *buf, gsize len, GError **err)
+{
+    guchar *p = buf;
+
+    while (len > 0)
+    {
+        gssize n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+        {
+            g_set_error(err, G_IO_ERROR, g_io_error_from_errno(errno),
+                    "Failed to read from i3: %s", g_strerror(errno));
+            return FALSE;
+        }
+        if (n == 0)
+        {
+            g_set_error(err, G_IO_ERROR, G_IO_ERROR_CLOSED, "i3 closed the connection");
+            return FALSE;
+        }
+        p += n;
+        len -= n;
+    }
+
+    return TRUE;
+}
@@ -0,0 +1,76 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_IPC_SOCKET_H__
+#define __I3W_IPC_SOCKET_H__
+
+#include <glib.h>
+#include <json-glib/json-glib.h>
+
+/*
+ * Minimal blocking client of the i3 IPC protocol, for the code which talks
+ * to i3 outside of the main thread where the i3ipc-glib connection lives.
+ */
+
+#define I3W_IPC_MAGIC "i3-ipc"
+#define I3W_IPC_EVENT_MASK (1u << 31)
+
+typedef enum
+{
+    I3W_IPC_COMMAND = 0,
+    I3W_IPC_GET_WORKSPACES = 1,
+    I3W_IPC_SUBSCRIBE = 2,
+    I3W_IPC_GET_OUTPUTS = 3,
+    I3W_IPC_GET_TREE = 4,
+    I3W_IPC_SEND_TICK = 10
+} i3wIpcMessageType;
+
+typedef enum
+{
+    I3W_IPC_EVENT_WORKSPACE = 0,
+    I3W_IPC_EVENT_OUTPUT = 1,
+    I3W_IPC_EVENT_MODE = 2,
+    I3W_IPC_EVENT_WINDOW = 3,
+    I3W_IPC_EVENT_BARCONFIG_UPDATE = 4,
+    I3W_IPC_EVENT_BINDING = 5,
+    I3W_IPC_EVENT_SHUTDOWN = 6,
+    I3W_IPC_EVENT_TICK = 7
+} i3wIpcEventType;
+
+gchar *
+i3w_ipc_socket_path(void);
+
+gint
+i3w_ipc_connect(const gchar *path, GError **err);
+
+gboolean
+i3w_ipc_send(gint fd, guint32 type, const gchar *payload, GError **err);
+
+gchar *
+i3w_ipc_recv(gint fd, guint32 *type, GError **err);
+
+JsonArray *
+i3w_ipc_query_array(gint fd, guint32 type, JsonParser *parser, GError **err);
+
+gboolean
+i3w_ipc_pending(gint fd);
+
+const gchar *
+i3w_ipc_json_string(JsonObject *object, const gchar *member);
+
+#endif /* !__I3W_IPC_SOCKET_H__ */
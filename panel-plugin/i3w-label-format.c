@@ -0,0 +1,275 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "i3w-label-format.h"
+
+typedef struct
+{
+    const gchar *key;
+    i3wLabelOpType type;
+} i3wLabelPlaceholder;
+
+static const i3wLabelPlaceholder placeholders[] =
+{
+    { "num", I3W_LABEL_OP_NUM },
+    { "name", I3W_LABEL_OP_NAME },
+    { "short_name", I3W_LABEL_OP_SHORT_NAME },
+    { "output", I3W_LABEL_OP_OUTPUT },
+    { "windows", I3W_LABEL_OP_WINDOWS },
+};
+
+/*
+ * Prototypes
+ */
+static void
+append_op(i3wLabelFormat *format, i3wLabelOpType type, const gchar *text, gsize len);
+static gboolean
+lookup_placeholder(const gchar *key, gsize len, i3wLabelOpType *type);
+static void
+append_escaped(GString *out, const gchar *text);
+
+/*
+ * Implementations of public functions
+ */
+
+/**
+ * i3w_label_format_compile:
+ * @template: the label template, may contain Pango markup
+ *
+ * Parse the template into a list of operations. Unknown placeholders are
+ * kept as literal text.
+ *
+ * Returns: the compiled format, free with i3w_label_format_free()
+ */
+i3wLabelFormat *
+i3w_label_format_compile(const gchar *template)
+{
+    i3wLabelFormat *format = g_new0(i3wLabelFormat, 1);
+    format->template = g_strdup(template ? template : "");
+    format->ops = g_array_new(FALSE, FALSE, sizeof(i3wLabelOp));
+
+    const gchar *literal = format->template;
+    const gchar *p = format->template;
+    while (*p)
+    {
+        const gchar *close;
+        i3wLabelOpType type;
+
+        if (*p == '{' && (close = strchr(p + 1, '}')) != NULL &&
+            lookup_placeholder(p + 1, close - p - 1, &type))
+        {
+            append_op(format, I3W_LABEL_OP_TEXT, literal, p - literal);
+            append_op(format, type, NULL, 0);
+            if (type == I3W_LABEL_OP_WINDOWS)
+                format->uses_windows = TRUE;
+
+            p = close + 1;
+            literal = p;
+        }
+        else
+        {
+            p++;
+        }
+    }
+    append_op(format, I3W_LABEL_OP_TEXT, literal, p - literal);
+
+    return format;
+}
+
+/**
+ * i3w_label_format_free:
+ * @format: the compiled format
+ *
+ * Free the compiled format.
+ */
+void
+i3w_label_format_free(i3wLabelFormat *format)
+{
+    if (!format)
+        return;
+
+    g_array_free(format->ops, TRUE);
+    g_free(format->template);
+    g_free(format);
+}
+
+/**
+ * i3w_label_format_uses_windows:
+ * @format: the compiled format
+ *
+ * Returns: TRUE if the format needs the window count of the workspaces
+ */
+gboolean
+i3w_label_format_uses_windows(const i3wLabelFormat *format)
+{
+    return format->uses_windows;
+}
+
+/**
+ * i3w_label_format_render:
+ * @format: the compiled format
+ * @workspace: the workspace to render the label for
+ * @out: the buffer to render into, it is truncated first
+ *
+ * Render the label of the workspace. Substituted values are markup-escaped,
+ * the literal parts of the template are copied as-is.
+ */
+void
+i3w_label_format_render(const i3wLabelFormat *format,
+        const i3workspace *workspace, GString *out)
+{
+    guint i;
+
+    g_string_truncate(out, 0);
+
+    for (i = 0; i < format->ops->len; i++)
+    {
+        const i3wLabelOp *op = &g_array_index(format->ops, i3wLabelOp, i);
+
+        switch (op->type)
+        {
+            case I3W_LABEL_OP_TEXT:
+                g_string_append_len(out, op->text, op->len);
+                break;
+            case I3W_LABEL_OP_NUM:
+                if (workspace->num >= 0)
+                    g_string_append_printf(out, "%d", workspace->num);
+                break;
+            case I3W_LABEL_OP_NAME:
+                append_escaped(out, workspace->name);
+                break;
+            case I3W_LABEL_OP_SHORT_NAME:
+                append_escaped(out, i3w_workspace_short_name(workspace));
+                break;
+            case I3W_LABEL_OP_OUTPUT:
+                append_escaped(out, workspace->output);
+                break;
+            case I3W_LABEL_OP_WINDOWS:
+                g_string_append_printf(out, "%d", workspace->windows);
+                break;
+        }
+    }
+}
+
+/**
+ * i3w_workspace_short_name:
+ * @workspace: the workspace
+ *
+ * Strips the workspace number, and the colon following it, from the name of
+ * a numbered workspace. The name is returned unchanged if nothing would be
+ * left of it.
+ *
+ * Returns: a pointer into the workspace name, no allocation is made
+ */
+const gchar *
+i3w_workspace_short_name(const i3workspace *workspace)
+{
+    const gchar *name = workspace->name;
+
+    if (workspace->num < 0)
+        return name;
+
+    const gchar *p = name;
+    while (g_ascii_isdigit(*p))
+        p++;
+    if (*p == ':')
+        p++;
+
+    return *p ? p : name;
+}
+
+/*
+ * Implementations of private functions
+ */
+
+/**
+ * append_op:
+ * @format: the format being compiled
+ * @type: the operation type
+ * @text: literal text, for I3W_LABEL_OP_TEXT
+ * @len: the length of the literal text
+ *
+ * Append an operation to the format. Empty literals are dropped.
+ */
+static void
+append_op(i3wLabelFormat *format, i3wLabelOpType type, const gchar *text, gsize len)
+{
+    if (type == I3W_LABEL_OP_TEXT && len == 0)
+        return;
+
+    i3wLabelOp op = { type, text, len };
+    g_array_append_val(format->ops, op);
+}
+
+/**
+ * lookup_placeholder:
+ * @key: the placeholder name, not NUL terminated
+ * @len: the length of the placeholder name
+ * @type: return location for the operation type
+ *
+ * Returns: TRUE if the key names a known placeholder
+ */
+static gboolean
+lookup_placeholder(const gchar *key, gsize len, i3wLabelOpType *type)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(placeholders); i++)
+    {
+        if (strlen(placeholders[i].key) == len &&
+            strncmp(placeholders[i].key, key, len) == 0)
+        {
+            *type = placeholders[i].type;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * append_escaped:
+ * @out: the buffer
+ * @text: the text to append
+ *
+ * Append the text escaping the characters which are special in Pango markup,
+ * without the temporary allocation of g_markup_escape_text().
+ */
+static void
+append_escaped(GString *out, const gchar *text)
+{
+    const gchar *p;
+
+    if (!text)
+        return;
+
+    for (p = text; *p; p++)
+    {
+        switch (*p)
+        {
+            case '&': g_string_append(out, "&amp;"); break;
+            case '<': g_string_append(out, "&lt;"); break;
+            case '>': g_string_append(out, "&gt;"); break;
+            case '\'': g_string_append(out, "&apos;"); break;
+            case '"': g_string_append(out, "&quot;"); break;
+            default: g_string_append_c(out, *p); break;
+        }
+    }
+}
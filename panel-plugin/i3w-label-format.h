@@ -0,0 +1,73 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_LABEL_FORMAT_H__
+#define __I3W_LABEL_FORMAT_H__
+
+#include <glib.h>
+
+#include "i3wm-delegate.h"
+
+/*
+ * A label template such as "{num}: {short_name}" compiled into a flat list
+ * of operations, so rendering a button label is a single pass over the list
+ * without any parsing or allocation.
+ */
+
+typedef enum
+{
+    I3W_LABEL_OP_TEXT,
+    I3W_LABEL_OP_NUM,
+    I3W_LABEL_OP_NAME,
+    I3W_LABEL_OP_SHORT_NAME,
+    I3W_LABEL_OP_OUTPUT,
+    I3W_LABEL_OP_WINDOWS
+} i3wLabelOpType;
+
+typedef struct _i3w_label_op
+{
+    i3wLabelOpType type;
+    // literal text, only used by I3W_LABEL_OP_TEXT
+    const gchar *text;
+    gsize len;
+} i3wLabelOp;
+
+typedef struct _i3w_label_format
+{
+    gchar *template;
+    GArray *ops;
+    gboolean uses_windows;
+} i3wLabelFormat;
+
+i3wLabelFormat *
+i3w_label_format_compile(const gchar *template);
+
+void
+i3w_label_format_free(i3wLabelFormat *format);
+
+gboolean
+i3w_label_format_uses_windows(const i3wLabelFormat *format);
+
+void
+i3w_label_format_render(const i3wLabelFormat *format,
+        const i3workspace *workspace, GString *out);
+
+const gchar *
+i3w_workspace_short_name(const i3workspace *workspace);
+
+#endif /* !__I3W_LABEL_FORMAT_H__ */
@@ -0,0 +1,233 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gprintf.h>
+#include <glib-unix.h>
+
+#include "i3w-latency.h"
+#include "i3w-ipc-socket.h"
+#include "i3w-stats.h"
+
+struct _i3w_latency
+{
+    gint fd;
+    guint watch;
+    guint timer;
+
+    // the payload of the tick in flight and when it was sent, 0 if none
+    guint sequence;
+    gchar payload[48];
+    gint64 sent;
+};
+
+/*
+ * Prototypes
+ */
+
+static gboolean
+on_probe_timer(gpointer data);
+
+static gboolean
+on_readable(gint fd, GIOCondition condition, gpointer data);
+
+static void
+handle_tick(i3wLatency *latency, const gchar *message);
+
+/*
+ * Implementations of public functions
+ */
+
+/**
+ * i3w_latency_new:
+ * @socket_path: the path of the i3 socket
+ * @interval: seconds between the probes, 0 for i3w_latency_probe() only
+ * @err: the error object
+ *
+ * Connect to i3 and subscribe to the tick events.
+ *
+ * Returns: the probe, NULL on error
+ */
+i3wLatency *
+i3w_latency_new(const gchar *socket_path, guint interval, GError **err)
+{
+    GError *tmp_err = NULL;
+    guint32 type;
+
+    gint fd = i3w_ipc_connect(socket_path, &tmp_err);
+    if (fd < 0)
+    {
+        g_propagate_error(err, tmp_err);
+        return NULL;
+    }
+
+    gchar *reply = NULL;
+    if (i3w_ipc_send(fd, I3W_IPC_SUBSCRIBE, "[\"tick\"]", &tmp_err))
+        reply = i3w_ipc_recv(fd, &type, &tmp_err);
+
+    if (!reply)
+    {
+        close(fd);
+        g_propagate_error(err, tmp_err);
+        return NULL;
+    }
+    g_free(reply);
+
+    i3wLatency *latency = g_new0(i3wLatency, 1);
+    latency->fd = fd;
+    latency->watch = g_unix_fd_add(fd, G_IO_IN | G_IO_HUP | G_IO_ERR, on_readable, latency);
+    if (interval)
+        latency->timer = g_timeout_add_seconds(interval, on_probe_timer, latency);
+
+    return latency;
+}
+
+/**
+ * i3w_latency_free:
+ * @latency: the probe
+ *
+ * Stop probing and close the connection.
+ */
+void
+i3w_latency_free(i3wLatency *latency)
+{
+    if (latency->timer)
+        g_source_remove(latency->timer);
+    if (latency->watch)
+        g_source_remove(latency->watch);
+    if (latency->fd >= 0)
+        close(latency->fd);
+
+    g_free(latency);
+}
+
+/**
+ * i3w_latency_probe:
+ * @latency: the probe
+ *
+ * Send a tick now. A tick still in flight is given up, it only counts as
+ * lost when it never arrives.
+ */
+void
+i3w_latency_probe(i3wLatency *latency)
+{
+    GError *err = NULL;
+
+    if (latency->fd < 0)
+        return;
+
+    g_snprintf(latency->payload, sizeof(latency->payload), "i3w-latency-%d-%u",
+            (gint) getpid(), ++latency->sequence);
+    latency->sent = g_get_monotonic_time();
+
+    if (!i3w_ipc_send(latency->fd, I3W_IPC_SEND_TICK, latency->payload, &err))
+    {
+        g_printf("Failed to send the latency probe: %s\n", err->message);
+        g_error_free(err);
+        latency->sent = 0;
+    }
+}
+
+/*
+ * Implementations of private functions
+ */
+
+/**
+ * on_probe_timer:
+ * @data: the probe
+ *
+ * Returns: G_SOURCE_CONTINUE
+ */
+static gboolean
+on_probe_timer(gpointer data)
+{
+    i3w_stats_add(I3W_STAT_TIMER_WAKEUPS, 1);
+    i3w_latency_probe((i3wLatency *) data);
+
+    return G_SOURCE_CONTINUE;
+}
+
+/**
+ * on_readable:
+ * @fd: the connection
+ * @condition: the condition of the connection
+ * @data: the probe
+ *
+ * Read the reply of the SEND_TICK or a tick event. The messages are small,
+ * so once readable a whole one is there. The probe stops when i3 goes away.
+ *
+ * Returns: G_SOURCE_CONTINUE while connected
+ */
+static gboolean
+on_readable(gint fd, GIOCondition condition, gpointer data)
+{
+    i3wLatency *latency = (i3wLatency *) data;
+    guint32 type;
+
+    gchar *message = i3w_ipc_recv(fd, &type, NULL);
+    if (!message)
+    {
+        if (latency->timer)
+            g_source_remove(latency->timer);
+        latency->timer = 0;
+        latency->watch = 0;
+        close(latency->fd);
+        latency->fd = -1;
+        return G_SOURCE_REMOVE;
+    }
+
+    if (type == (I3W_IPC_EVENT_MASK | I3W_IPC_EVENT_TICK))
+        handle_tick(latency, message);
+
+    g_free(message);
+
+    return G_SOURCE_CONTINUE;
+}
+
+/**
+ * handle_tick:
+ * @latency: the probe
+ * @message: the JSON of the tick event
+ *
+ * Record the round trip if this is the tick in flight. The ticks of other
+ * clients and the one sent on subscribing are ignored.
+ */
+static void
+handle_tick(i3wLatency *latency, const gchar *message)
+{
+    JsonParser *parser;
+
+    if (!latency->sent)
+        return;
+
+    parser = json_parser_new();
+    if (json_parser_load_from_data(parser, message, -1, NULL) &&
+        JSON_NODE_HOLDS_OBJECT(json_parser_get_root(parser)))
+    {
+        JsonObject *root = json_node_get_object(json_parser_get_root(parser));
+        if (g_strcmp0(i3w_ipc_json_string(root, "payload"), latency->payload) == 0)
+        {
+            i3w_stats_record(I3W_TIMING_TICK_ROUND_TRIP, latency->sent);
+            latency->sent = 0;
+        }
+    }
+
+    g_object_unref(parser);
+}
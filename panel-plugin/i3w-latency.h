@@ -0,0 +1,42 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_LATENCY_H__
+#define __I3W_LATENCY_H__
+
+#include <glib.h>
+
+/*
+ * Measures the round trip of a tick through i3: a SEND_TICK with a unique
+ * payload is sent on a connection of its own, subscribed to the tick
+ * events, and the time until the main loop handles the matching event is
+ * recorded in the I3W_TIMING_TICK_ROUND_TRIP histogram.
+ */
+
+typedef struct _i3w_latency i3wLatency;
+
+i3wLatency *
+i3w_latency_new(const gchar *socket_path, guint interval, GError **err);
+
+void
+i3w_latency_free(i3wLatency *latency);
+
+void
+i3w_latency_probe(i3wLatency *latency);
+
+#endif /* !__I3W_LATENCY_H__ */
@@ -27,6 +27,32 @@
 #include <glib/gprintf.h>
 
 #include "i3w-plugin.h"
+#include "i3w-icon-cache.h"
+#include "i3w-probes.h"
+#include "i3w-stats.h"
+#include "i3w-snapshot.h"
+#include "i3w-css.h"
+#include "i3w-bar-theme.h"
+#include "i3w-trace.h"
+
+#define APP_ICON_SIZE 16
+
+// one pulse of the urgent buttons and how far they fade out
+#define URGENT_PULSE_PERIOD (G_USEC_PER_SEC * 3 / 2)
+#define URGENT_PULSE_MIN_OPACITY 0.4
+
+// the delay of the connection attempts while i3 is not there, in seconds
+#define RECONNECT_MIN_DELAY 1
+#define RECONNECT_MAX_DELAY 32
+
+// the longest range of pinned workspaces expanded
+#define MAX_PINNED_RANGE 100
+
+// how long the workspace snapshot is written after the last change, in seconds
+#define SNAPSHOT_SAVE_DELAY 5
+
+// how long a clicked workspace is shown focused without i3 confirming it
+#define PENDING_FOCUS_TIMEOUT 1000
 
 /* prototypes */
 
@@ -36,6 +62,34 @@ connect_callbacks(i3WorkspacesPlugin *i3_workspaces);
 static void
 init_css(i3WorkspacesPlugin *i3_workspaces);
 
+static void
+init_label_format(i3WorkspacesPlugin *i3_workspaces);
+static void
+init_stable_layout(i3WorkspacesPlugin *i3_workspaces);
+static void
+init_pinned_workspaces(i3WorkspacesPlugin *i3_workspaces);
+static gint
+workspace_num(const gchar *name);
+static void
+on_font_changed(GtkSettings *settings, GParamSpec *pspec, gpointer data);
+static void
+set_stable_width(GtkWidget *button, GtkWidget *label, const gchar *markup,
+        i3WorkspacesPlugin *i3_workspaces);
+
+static void
+update_delegate_features(i3WorkspacesPlugin *i3_workspaces);
+static i3wmEventSource
+event_source(i3WorkspacesConfig *config);
+
+static void
+init_thumbnails(i3WorkspacesPlugin *i3_workspaces);
+static void
+refresh_thumbnails(i3wThumbnails *thumbnails, gpointer data);
+static void
+init_window_titles(i3WorkspacesPlugin *i3_workspaces);
+static void
+on_window_titles_ready(i3wWindowTitles *titles, gpointer data);
+
 static i3WorkspacesPlugin *
 construct_workspaces(XfcePanelPlugin *plugin);
 
@@ -60,20 +114,68 @@ config_changed(gpointer cb_data);
 
 static void
 add_workspaces(i3WorkspacesPlugin *i3_workspaces);
+static gboolean
+button_is_current(GtkWidget *button, i3WorkspacesPlugin *i3_workspaces);
+static GtkWidget *
+create_workspace_button(i3WorkspacesPlugin *i3_workspaces, i3workspace *workspace);
 static void
 remove_workspaces(i3WorkspacesPlugin *i3_workspaces);
 
+static void
+load_snapshot(i3WorkspacesPlugin *i3_workspaces);
+static gboolean
+save_snapshot(gpointer data);
+static void
+drop_snapshot(i3WorkspacesPlugin *i3_workspaces);
+
 static void
 set_button_label(GtkWidget *button, i3workspace *workspace,
-        i3WorkspacesConfig *config);
+        i3WorkspacesPlugin *i3_workspaces);
+
+static void
+update_urgent_animation(i3WorkspacesPlugin *i3_workspaces);
+static void
+on_hvbox_mapped(GtkWidget *hvbox, gpointer data);
+static gboolean
+on_visibility_changed(GtkWidget *ebox, GdkEventVisibility *event, gpointer data);
+static void
+on_hierarchy_changed(GtkWidget *ebox, GtkWidget *previous, gpointer data);
+static void
+watch_toplevel(i3WorkspacesPlugin *i3_workspaces);
+static gboolean
+on_window_state_changed(GtkWidget *toplevel, GdkEventWindowState *event, gpointer data);
+static gboolean
+on_toplevel_configured(GtkWidget *toplevel, GdkEventConfigure *event, gpointer data);
+static gboolean
+is_off_monitor(i3WorkspacesPlugin *i3_workspaces);
+static void
+update_visibility(i3WorkspacesPlugin *i3_workspaces);
+static gboolean
+on_urgent_tick(GtkWidget *hvbox, GdkFrameClock *clock, gpointer data);
+static void
+set_urgent_opacity(i3WorkspacesPlugin *i3_workspaces, gdouble opacity);
 
-static gchar *
-strip_workspace_numbers(const gchar *name, int num);
+static void
+update_app_icons(GtkWidget *button, const gchar *workspace,
+        i3WorkspacesPlugin *i3_workspaces);
 
 static void
 on_workspace_clicked(GtkWidget *button, gpointer data);
 static gboolean
+send_pending_focus(gpointer data);
+static gboolean
+on_pending_focus_timeout(gpointer data);
+static void
+reconcile_pending_focus(i3WorkspacesPlugin *i3_workspaces);
+static void
+clear_pending_focus(i3WorkspacesPlugin *i3_workspaces);
+static void
+show_focus(i3WorkspacesPlugin *i3_workspaces, const gchar *workspace);
+static gboolean
 on_workspace_scrolled(GtkWidget *ebox, GdkEventScroll *ev, gpointer data);
+static gboolean
+on_workspace_query_tooltip(GtkWidget *button, gint x, gint y,
+        gboolean keyboard_mode, GtkTooltip *tooltip, gpointer data);
 
 static void
 on_workspace_created(gpointer data);
@@ -81,6 +183,10 @@ static void
 on_workspace_destroyed(gpointer data);
 static void
 on_workspace_changed(gpointer data);
+static void
+on_workspace_windows_changed(const gchar *workspace, gpointer data);
+static void
+on_window_titles_changed(const gchar *workspace, gpointer data);
 
 static void
 on_mode_changed(gchar *mode, gpointer data);
@@ -88,6 +194,9 @@ on_mode_changed(gchar *mode, gpointer data);
 static void
 on_output_changed(gchar *mode, gpointer data);
 
+static void
+on_bar_config_changed(gpointer data);
+
 static void
 on_ipc_shutdown(gpointer i3_w);
 
@@ -125,6 +234,12 @@ connect_callbacks(i3WorkspacesPlugin *i3_workspaces)
             on_mode_changed, i3_workspaces);
     i3wm_set_on_output_changed(i3_workspaces->i3wm,
             on_output_changed, i3_workspaces);
+    i3wm_set_on_workspace_windows_changed(i3_workspaces->i3wm,
+            on_workspace_windows_changed, i3_workspaces);
+    i3wm_set_on_window_titles_changed(i3_workspaces->i3wm,
+            on_window_titles_changed, i3_workspaces);
+    i3wm_set_on_bar_config_changed(i3_workspaces->i3wm,
+            on_bar_config_changed, i3_workspaces);
     i3wm_set_on_ipc_shutdown(i3_workspaces->i3wm,
             on_ipc_shutdown, i3_workspaces);
 }
@@ -133,17 +248,29 @@ connect_callbacks(i3WorkspacesPlugin *i3_workspaces)
  * init_css:
  * @i3_workspaces: the workspaces plugin
  *
- * Set the CSS for the application
+ * Set the CSS of the plugin widgets. Instances with the same stylesheet share
+ * the provider.
  */
 static void
 init_css(i3WorkspacesPlugin *i3_workspaces) {
     i3WorkspacesConfig *config = i3_workspaces->config;
+    gint64 trace = i3w_trace_begin();
+
+    GtkCssProvider *provider;
 
     if (config->use_css) {
-        gtk_css_provider_load_from_data(
-            i3_workspaces->css_provider, i3_workspaces->config->css, -1, NULL);
+        provider = i3w_css_provider_get(config->css ? config->css : "");
+    }
+    else if (config->use_bar_colors && i3_workspaces->bar_css) {
+        provider = i3w_css_provider_get(i3_workspaces->bar_css);
     }
     else {
+        gchar *normal = gdk_rgba_to_string(&config->normal_color);
+        gchar *visible = gdk_rgba_to_string(&config->visible_color);
+        gchar *focused = gdk_rgba_to_string(&config->focused_color);
+        gchar *urgent = gdk_rgba_to_string(&config->urgent_color);
+        gchar *mode = gdk_rgba_to_string(&config->mode_color);
+
         gchar *css = g_strdup_printf(
             ".workspace {\n"
             "  color: %s;\n"
@@ -158,20 +285,333 @@ init_css(i3WorkspacesPlugin *i3_workspaces) {
             ".workspace.urgent {\n"
             "  color: %s;\n"
             "}\n"
+            ".workspace.empty {\n"
+            "  opacity: 0.5;\n"
+            "}\n"
             ".binding-mode {\n"
             "  color: %s;\n"
             "}\n",
-            gdk_rgba_to_string(&config->normal_color),
-            gdk_rgba_to_string(&config->visible_color),
-            gdk_rgba_to_string(&config->focused_color),
-            gdk_rgba_to_string(&config->urgent_color),
-            gdk_rgba_to_string(&config->mode_color));
+            normal, visible, focused, urgent, mode);
 
-        gtk_css_provider_load_from_data(i3_workspaces->css_provider, css, -1, NULL);
+        provider = i3w_css_provider_get(css);
         g_free(css);
+        g_free(normal);
+        g_free(visible);
+        g_free(focused);
+        g_free(urgent);
+        g_free(mode);
+    }
+
+    if (provider != i3_workspaces->css_provider && i3_workspaces->ebox)
+        i3w_css_apply(i3_workspaces->ebox, i3_workspaces->css_provider, provider);
+    if (i3_workspaces->css_provider)
+        g_object_unref(i3_workspaces->css_provider);
+    i3_workspaces->css_provider = provider;
+
+    i3w_trace_end("init_css", trace, NULL, -1);
+}
+
+/**
+ * init_label_format:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Compile the label template of the buttons. An empty template stands for
+ * the workspace name, optionally stripped of the workspace number.
+ */
+static void
+init_label_format(i3WorkspacesPlugin *i3_workspaces)
+{
+    i3WorkspacesConfig *config = i3_workspaces->config;
+    const gchar *template = config->label_format;
+
+    if (!template || template[0] == 0)
+        template = config->strip_workspace_numbers ? "{short_name}" : "{name}";
+
+    i3w_label_format_free(i3_workspaces->label_format);
+    i3_workspaces->label_format = i3w_label_format_compile(template);
+}
+
+/**
+ * init_stable_layout:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Create or drop the cache of the label widths, depending on the config. It
+ * is emptied either way, since this runs on every style change.
+ */
+static void
+init_stable_layout(i3WorkspacesPlugin *i3_workspaces)
+{
+    if (i3_workspaces->config->stable_layout && !i3_workspaces->label_widths)
+    {
+        i3_workspaces->label_widths = g_hash_table_new_full(g_str_hash, g_str_equal,
+                g_free, NULL);
+    }
+    else if (!i3_workspaces->config->stable_layout && i3_workspaces->label_widths)
+    {
+        g_hash_table_destroy(i3_workspaces->label_widths);
+        i3_workspaces->label_widths = NULL;
+    }
+
+    if (i3_workspaces->label_widths)
+        g_hash_table_remove_all(i3_workspaces->label_widths);
+}
+
+/**
+ * init_pinned_workspaces:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Parse the pinned workspaces of the config: names separated by commas,
+ * where a numeric range like 1-10 stands for every number in it.
+ */
+static void
+init_pinned_workspaces(i3WorkspacesPlugin *i3_workspaces)
+{
+    GPtrArray *names = g_ptr_array_new();
+    gchar **tokens = g_strsplit(i3_workspaces->config->pinned_workspaces, ",", -1);
+
+    gchar **token;
+    for (token = tokens; *token; token++)
+    {
+        gchar *name = g_strstrip(*token);
+        gchar *end, *rest;
+
+        if (name[0] == 0)
+            continue;
+
+        guint64 first = g_ascii_strtoull(name, &end, 10);
+        if (end != name && *end == '-' && g_ascii_isdigit(end[1]))
+        {
+            guint64 last = g_ascii_strtoull(end + 1, &rest, 10);
+            if (*rest == 0 && first <= last && last - first < MAX_PINNED_RANGE)
+            {
+                for (; first <= last; first++)
+                    g_ptr_array_add(names, g_strdup_printf("%" G_GUINT64_FORMAT, first));
+                continue;
+            }
+        }
+
+        g_ptr_array_add(names, g_strdup(name));
+    }
+    g_ptr_array_add(names, NULL);
+    g_strfreev(tokens);
+
+    g_strfreev(i3_workspaces->pinned);
+    i3_workspaces->pinned = (gchar **) g_ptr_array_free(names, FALSE);
+}
+
+/**
+ * workspace_num:
+ * @name: the name of a workspace
+ *
+ * The number i3 gives to a workspace with this name.
+ *
+ * Returns: the leading number of the name or -1 if there is none.
+ */
+static gint
+workspace_num(const gchar *name)
+{
+    gchar *end;
+    gint64 num = g_ascii_strtoll(name, &end, 10);
+
+    if (end == name || num < 0 || num > G_MAXINT)
+        return -1;
+
+    return (gint) num;
+}
+
+/**
+ * on_font_changed:
+ * @settings: the gtk settings
+ * @pspec: the changed property
+ * @data: the workspaces plugin
+ *
+ * The default font changed, the labels are measured again.
+ */
+static void
+on_font_changed(GtkSettings *settings, GParamSpec *pspec, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+
+    if (!i3_workspaces->label_widths)
+        return;
+
+    init_stable_layout(i3_workspaces);
+    i3_workspaces->rendered_generation = 0;
+    on_workspace_changed(i3_workspaces);
+}
+
+/**
+ * update_delegate_features:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Tell the i3wm delegate which of the optional data the enabled features
+ * need.
+ */
+static void
+update_delegate_features(i3WorkspacesPlugin *i3_workspaces)
+{
+    GError *err = NULL;
+
+    if (!i3_workspaces->i3wm)
+        return;
+
+    i3wm_set_count_windows(i3_workspaces->i3wm,
+            i3w_label_format_uses_windows(i3_workspaces->label_format), &err);
+    if (err != NULL)
+    {
+        fprintf(stderr, "Failed to count the windows: %s\n", err->message);
+        g_error_free(err);
+        err = NULL;
+    }
+
+    i3wm_set_track_windows(i3_workspaces->i3wm,
+            i3_workspaces->config->show_app_icons, &err);
+    if (err != NULL)
+    {
+        fprintf(stderr, "Failed to track windows: %s\n", err->message);
+        g_error_free(err);
+        err = NULL;
+    }
+
+    i3wm_set_watch_window_titles(i3_workspaces->i3wm,
+            i3_workspaces->config->show_window_titles, &err);
+    if (err != NULL)
+    {
+        fprintf(stderr, "Failed to watch the window titles: %s\n", err->message);
+        g_error_free(err);
+        err = NULL;
+    }
+
+    i3wm_set_latency_probe_interval(i3_workspaces->i3wm,
+            i3_workspaces->config->latency_probe_interval, &err);
+    if (err != NULL)
+    {
+        fprintf(stderr, "Failed to start the latency probe: %s\n", err->message);
+        g_error_free(err);
+        err = NULL;
+    }
+
+    i3wm_set_watch_bar_config(i3_workspaces->i3wm,
+            !i3_workspaces->config->use_css && i3_workspaces->config->use_bar_colors, &err);
+    if (err != NULL)
+    {
+        fprintf(stderr, "Failed to get the bar configuration: %s\n", err->message);
+        g_error_free(err);
+    }
+    on_bar_config_changed(i3_workspaces);
+}
+
+/**
+ * event_source:
+ * @config: the plugin configuration
+ *
+ * Returns: where the i3wm delegate should get its events from
+ */
+static i3wmEventSource
+event_source(i3WorkspacesConfig *config)
+{
+    if (config->shared_helper)
+        return I3WM_EVENTS_HELPER;
+    if (config->ingest_thread)
+        return I3WM_EVENTS_THREAD;
+    return I3WM_EVENTS_CONNECTION;
+}
+
+/**
+ * init_thumbnails:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Create or destroy the thumbnail cache according to the configuration.
+ */
+static void
+init_thumbnails(i3WorkspacesPlugin *i3_workspaces)
+{
+    if (i3_workspaces->config->show_thumbnails && !i3_workspaces->thumbnails)
+    {
+        i3_workspaces->thumbnails = i3w_thumbnails_new(refresh_thumbnails, i3_workspaces);
+        i3w_thumbnails_invalidate(i3_workspaces->thumbnails);
+    }
+    else if (!i3_workspaces->config->show_thumbnails && i3_workspaces->thumbnails)
+    {
+        i3w_thumbnails_free(i3_workspaces->thumbnails);
+        i3_workspaces->thumbnails = NULL;
+    }
+}
+
+/**
+ * refresh_thumbnails:
+ * @thumbnails: the thumbnail cache
+ * @data: the workspaces plugin
+ *
+ * Capture the visible workspaces, each from the area of its output.
+ */
+static void
+refresh_thumbnails(i3wThumbnails *thumbnails, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+
+    if (!i3_workspaces->i3wm)
+        return;
+
+    i3_workspaces_outputs_t outputs = get_outputs();
+
+    GSList *witem;
+    for (witem = i3wm_get_workspaces(i3_workspaces->i3wm); witem != NULL; witem = witem->next)
+    {
+        i3workspace *workspace = (i3workspace *) witem->data;
+        if (!workspace->visible)
+            continue;
+
+        int o;
+        for (o = 0; o < outputs.num_outputs; ++o)
+        {
+            if (g_strcmp0(outputs.outputs[o].name, workspace->output) == 0)
+            {
+                GdkRectangle area = {
+                    outputs.outputs[o].x, outputs.outputs[o].y,
+                    outputs.outputs[o].width, outputs.outputs[o].height };
+                i3w_thumbnails_capture(thumbnails, workspace->name, &area);
+                break;
+            }
+        }
+    }
+
+    free_outputs(outputs);
+}
+
+/**
+ * init_window_titles:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Create or destroy the window title cache according to the configuration.
+ */
+static void
+init_window_titles(i3WorkspacesPlugin *i3_workspaces)
+{
+    if (i3_workspaces->config->show_window_titles && !i3_workspaces->window_titles)
+    {
+        i3_workspaces->window_titles = i3w_window_titles_new(on_window_titles_ready,
+                i3_workspaces);
+    }
+    else if (!i3_workspaces->config->show_window_titles && i3_workspaces->window_titles)
+    {
+        i3w_window_titles_free(i3_workspaces->window_titles);
+        i3_workspaces->window_titles = NULL;
     }
 }
 
+/**
+ * on_window_titles_ready:
+ * @titles: the window title cache
+ * @data: the workspaces plugin
+ *
+ * The titles asked for by a tooltip arrived, query the tooltip again.
+ */
+static void
+on_window_titles_ready(i3wWindowTitles *titles, gpointer data)
+{
+    gtk_tooltip_trigger_tooltip_query(gdk_display_get_default());
+}
 
 /**
  * construct_workspaces:
@@ -187,6 +627,9 @@ construct_workspaces(XfcePanelPlugin *plugin)
 
     i3WorkspacesPlugin *i3_workspaces;
     GtkOrientation orientation;
+
+    /* tracing is enabled by the environment, see i3w-trace.h */
+    i3w_trace_init();
     fprintf(stderr, "xfce4_i3_workspaces: construct_workspace, plugin=%p\n",
             plugin);
 
@@ -200,25 +643,29 @@ construct_workspaces(XfcePanelPlugin *plugin)
     i3_workspaces->config = i3_workspaces_config_new();
     i3_workspaces_config_load(i3_workspaces->config, plugin);
 
+    /* button labels */
+    i3_workspaces->label_buffer = g_string_new(NULL);
+    init_label_format(i3_workspaces);
+    init_thumbnails(i3_workspaces);
+    init_window_titles(i3_workspaces);
+
     /* get the current orientation */
     orientation = xfce_panel_plugin_get_orientation (plugin);
 
     /* set up css */
     i3WorkspacesConfig *config = i3_workspaces->config;
-    GdkScreen *screen = gdk_screen_get_default();
-    i3_workspaces->css_provider = gtk_css_provider_new();
-    gtk_style_context_add_provider_for_screen(
-        screen,
-        GTK_STYLE_PROVIDER(i3_workspaces->css_provider),
-        GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
     init_css(i3_workspaces);
+    init_stable_layout(i3_workspaces);
+    init_pinned_workspaces(i3_workspaces);
+    g_signal_connect(G_OBJECT(gtk_settings_get_default()), "notify::gtk-font-name",
+            G_CALLBACK(on_font_changed), i3_workspaces);
 
     /* create some panel widgets */
     i3_workspaces->ebox = gtk_event_box_new();
     gtk_widget_show(i3_workspaces->ebox);
 
     /* listen for scroll events */
-    gtk_widget_add_events(i3_workspaces->ebox, GDK_SCROLL_MASK);
+    gtk_widget_add_events(i3_workspaces->ebox, GDK_SCROLL_MASK | GDK_VISIBILITY_NOTIFY_MASK);
     g_signal_connect(G_OBJECT(i3_workspaces->ebox), "scroll-event",
             G_CALLBACK(on_workspace_scrolled), i3_workspaces);
 
@@ -226,6 +673,16 @@ construct_workspaces(XfcePanelPlugin *plugin)
     gtk_widget_show(i3_workspaces->hvbox);
     gtk_container_add(GTK_CONTAINER(i3_workspaces->ebox), i3_workspaces->hvbox);
 
+    /* no updates while the panel is hidden */
+    g_signal_connect(G_OBJECT(i3_workspaces->ebox), "visibility-notify-event",
+            G_CALLBACK(on_visibility_changed), i3_workspaces);
+    g_signal_connect(G_OBJECT(i3_workspaces->ebox), "hierarchy-changed",
+            G_CALLBACK(on_hierarchy_changed), i3_workspaces);
+    g_signal_connect(G_OBJECT(i3_workspaces->hvbox), "map",
+            G_CALLBACK(on_hvbox_mapped), i3_workspaces);
+    g_signal_connect(G_OBJECT(i3_workspaces->hvbox), "unmap",
+            G_CALLBACK(on_hvbox_mapped), i3_workspaces);
+
     i3_workspaces->workspace_buttons = g_hash_table_new(g_direct_hash, g_direct_equal);
 
     /* Add a label for the binding mode */
@@ -236,6 +693,12 @@ construct_workspaces(XfcePanelPlugin *plugin)
     gtk_box_pack_end(GTK_BOX(i3_workspaces->hvbox), i3_workspaces->mode_label, FALSE, FALSE, 0);
     gtk_widget_show(i3_workspaces->mode_label);
 
+    i3w_css_apply(i3_workspaces->ebox, NULL, i3_workspaces->css_provider);
+
+    /* Show the workspaces of the last session until i3 answers */
+    load_snapshot(i3_workspaces);
+    add_workspaces(i3_workspaces);
+
     /* Setup a timer to connect to the i3wm until success. */
     reconnect_i3wm_timer(i3_workspaces);
 
@@ -275,6 +738,9 @@ construct(XfcePanelPlugin *plugin)
     /* show the configure menu item */
     xfce_panel_plugin_menu_show_configure(plugin);
 
+    /* print the statistics on SIGUSR1 */
+    i3w_stats_dump_on_signal();
+
     /* Auto-detect output configuration */
     handle_change_output(i3_workspaces);
 }
@@ -289,12 +755,36 @@ construct(XfcePanelPlugin *plugin)
 static void
 destruct(XfcePanelPlugin *plugin, i3WorkspacesPlugin *i3_workspaces)
 {
+    /* write out the pending trace events */
+    i3w_trace_flush();
+
     /* save configuration */
     i3_workspaces_config_save(i3_workspaces->config, plugin);
     i3_workspaces_config_free(i3_workspaces->config);
 
     /* destroy the panel widgets */
+    if (i3_workspaces->urgent_tick)
+        gtk_widget_remove_tick_callback(i3_workspaces->hvbox, i3_workspaces->urgent_tick);
+    remove_workspaces(i3_workspaces);
     gtk_widget_destroy(i3_workspaces->hvbox);
+    if (i3_workspaces->toplevel)
+    {
+        g_signal_handlers_disconnect_by_data(i3_workspaces->toplevel, i3_workspaces);
+        g_object_remove_weak_pointer(G_OBJECT(i3_workspaces->toplevel),
+                (gpointer *) &i3_workspaces->toplevel);
+    }
+
+    clear_pending_focus(i3_workspaces);
+
+    /* write the pending snapshot */
+    if (i3_workspaces->snapshot_save)
+    {
+        g_source_remove(i3_workspaces->snapshot_save);
+        save_snapshot(i3_workspaces);
+    }
+    drop_snapshot(i3_workspaces);
+    g_free(i3_workspaces->snapshot_path);
+    g_free(i3_workspaces->snapshot_data);
 
     /* cancel the timer */
     if (i3_workspaces->timeout) {
@@ -308,6 +798,22 @@ destruct(XfcePanelPlugin *plugin, i3WorkspacesPlugin *i3_workspaces)
         i3_workspaces->i3wm = NULL;
     }
 
+    g_object_unref(i3_workspaces->css_provider);
+    g_free(i3_workspaces->bar_css);
+    i3w_label_format_free(i3_workspaces->label_format);
+    g_string_free(i3_workspaces->label_buffer, TRUE);
+    g_signal_handlers_disconnect_by_data(gtk_settings_get_default(), i3_workspaces);
+    if (i3_workspaces->label_widths)
+        g_hash_table_destroy(i3_workspaces->label_widths);
+    g_strfreev(i3_workspaces->pinned);
+    i3w_snapshot_free(i3_workspaces->placeholders);
+    g_free(i3_workspaces->pending_mode);
+
+    if (i3_workspaces->thumbnails)
+        i3w_thumbnails_free(i3_workspaces->thumbnails);
+    if (i3_workspaces->window_titles)
+        i3w_window_titles_free(i3_workspaces->window_titles);
+
     /* free the plugin structure */
     g_slice_free(i3WorkspacesPlugin, i3_workspaces);
 }
@@ -384,68 +890,333 @@ config_changed(gpointer cb_data)
     i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) cb_data;
 
     init_css(i3_workspaces);
-    handle_change_output(i3_workspaces);
-    remove_workspaces(i3_workspaces);
-    add_workspaces(i3_workspaces);
+    init_stable_layout(i3_workspaces);
+    init_label_format(i3_workspaces);
+    init_pinned_workspaces(i3_workspaces);
+    init_thumbnails(i3_workspaces);
+    init_window_titles(i3_workspaces);
+
+    /* The event source is chosen at connect time, so reconnect */
+    if (i3_workspaces->i3wm &&
+        i3_workspaces->i3wm->event_source != event_source(i3_workspaces->config))
+    {
+        on_ipc_shutdown(i3_workspaces);
+        return;
+    }
+
+    update_delegate_features(i3_workspaces);
+
+    /* the labels depend on the configuration, the buttons built for another
+     * one are replaced by add_workspaces */
+    i3_workspaces->rendered_generation = 0;
+    if (i3_workspaces->config->auto_detect_outputs)
+        handle_change_output(i3_workspaces);
+    else
+        add_workspaces(i3_workspaces);
 }
 
 /**
  * add_workspaces:
  * @i3_workspaces: the workspaces plugin
  *
- * Add the workspaces.
+ * Add the workspaces, from the snapshot while not connected. The buttons
+ * already shown are reused for the workspaces of the same name, unless
+ * they were built for another configuration, the others are removed.
  */
 static void
 add_workspaces(i3WorkspacesPlugin *i3_workspaces)
 {
-    g_assert(i3_workspaces->i3wm);
-    GSList *wlist = i3wm_get_workspaces(i3_workspaces->i3wm);
+    gint64 trace = i3w_trace_begin();
+    i3wmWorkspaces *snapshot = i3_workspaces->i3wm ?
+        i3wm_ref_workspaces(i3_workspaces->i3wm) : NULL;
+    GSList *wlist = snapshot ? snapshot->wlist : i3_workspaces->snapshot;
+
+    // workspace name => the button shown for it so far
+    GHashTable *shown = g_hash_table_new(g_str_hash, g_str_equal);
+    GHashTableIter iter;
+    gpointer button;
+
+    g_hash_table_iter_init(&iter, i3_workspaces->workspace_buttons);
+    while (g_hash_table_iter_next(&iter, NULL, &button))
+        g_hash_table_insert(shown, g_object_get_data(G_OBJECT(button), "workspace-name"), button);
+    g_hash_table_remove_all(i3_workspaces->workspace_buttons);
 
-    GSList *witem;
+    GSList *workspaces = NULL, *witem;
     for (witem = wlist; witem != NULL; witem = witem->next)
     {
         i3workspace *workspace = (i3workspace *) witem->data;
         if (workspace &&
             (i3_workspaces->config->output[0] == 0 ||
              g_strcmp0(i3_workspaces->config->output, workspace->output) == 0))
-        {
-            GtkWidget * button;
-            button = xfce_panel_create_button();
-            GtkStyleContext *context = gtk_widget_get_style_context(button);
-            gtk_style_context_add_class(context, "workspace");
+            workspaces = g_slist_prepend(workspaces, workspace);
+    }
 
-            gtk_button_set_label(GTK_BUTTON(button), workspace->name);
+    /* the pinned workspaces i3 does not have at all get a placeholder */
+    i3w_snapshot_free(i3_workspaces->placeholders);
+    i3_workspaces->placeholders = NULL;
+    gchar **pinned;
+    for (pinned = i3_workspaces->pinned; pinned && *pinned; pinned++)
+    {
+        gboolean exists = FALSE;
+        for (witem = wlist; witem != NULL && !exists; witem = witem->next)
+            exists = g_strcmp0(((i3workspace *) witem->data)->name, *pinned) == 0;
 
-            set_button_label(button, workspace, i3_workspaces->config);
+        if (!exists)
+        {
+            i3workspace *placeholder = g_new0(i3workspace, 1);
+            placeholder->num = workspace_num(*pinned);
+            placeholder->name = g_strdup(*pinned);
+            i3_workspaces->placeholders = g_slist_prepend(i3_workspaces->placeholders, placeholder);
+            workspaces = g_slist_prepend(workspaces, placeholder);
+        }
+    }
 
-            g_signal_connect(G_OBJECT(button), "clicked",
-                    G_CALLBACK(on_workspace_clicked), i3_workspaces);
+    if (i3_workspaces->placeholders)
+        workspaces = g_slist_sort(workspaces, (GCompareFunc) i3wm_workspace_cmp);
+    else
+        workspaces = g_slist_reverse(workspaces);
 
-            /* show the panel's right-click menu on this button */
-            xfce_panel_plugin_add_action_widget(i3_workspaces->plugin, button);
+    for (witem = workspaces; witem != NULL; witem = witem->next)
+    {
+        i3workspace *workspace = (i3workspace *) witem->data;
+        button = g_hash_table_lookup(shown, workspace->name);
 
-            /* avoid acceleration key interference */
-            gtk_button_set_use_underline(GTK_BUTTON(button), FALSE);
-            gtk_box_pack_end(GTK_BOX(i3_workspaces->hvbox), button, FALSE, FALSE, 0);
-            gtk_widget_show(button);
+        /* left in shown, it goes with the stale ones */
+        if (button && !button_is_current(button, i3_workspaces))
+            button = NULL;
 
-            g_hash_table_insert(i3_workspaces->workspace_buttons, workspace, button);
+        if (button)
+        {
+            g_hash_table_remove(shown, workspace->name);
+
+            /* same place as a newly packed button */
+            gtk_box_reorder_child(GTK_BOX(i3_workspaces->hvbox), button, -1);
+            if (!snapshot || workspace->generation > i3_workspaces->rendered_generation ||
+                g_slist_find(i3_workspaces->placeholders, workspace))
+                set_button_label(button, workspace, i3_workspaces);
+            update_app_icons(button, workspace->name, i3_workspaces);
         }
+        else
+        {
+            button = create_workspace_button(i3_workspaces, workspace);
+        }
+
+        GtkStyleContext *context = gtk_widget_get_style_context(button);
+        if (g_slist_find(i3_workspaces->placeholders, workspace))
+            gtk_style_context_add_class(context, "empty");
+        else
+            gtk_style_context_remove_class(context, "empty");
+
+        g_hash_table_insert(i3_workspaces->workspace_buttons, workspace, button);
     }
-}
+    g_slist_free(workspaces);
 
-/**
- * remove_workspaces:
- * @i3_workspaces: the workspaces plugin
+    /* the old keys are gone, the previous snapshot can go too */
+    if (i3_workspaces->workspaces)
+        i3wm_unref_workspaces(i3_workspaces->workspaces);
+    i3_workspaces->workspaces = snapshot;
+    i3_workspaces->rendered_generation = snapshot ? snapshot->generation : 0;
+
+    GList *stale = g_hash_table_get_values(shown);
+    gint removed = g_list_length(stale);
+    g_list_free_full(stale, (GDestroyNotify) gtk_widget_destroy);
+    g_hash_table_destroy(shown);
+
+    i3w_stats_add(I3W_STAT_BUTTONS_DESTROYED, removed);
+    i3w_stats_add(I3W_STAT_LIVE_BUTTONS, -removed);
+
+    update_urgent_animation(i3_workspaces);
+
+    i3w_trace_end("add_workspaces", trace, i3_workspaces->i3wm ? NULL : "snapshot",
+            g_hash_table_size(i3_workspaces->workspace_buttons));
+
+    if (i3_workspaces->i3wm && !i3_workspaces->snapshot_save)
+    {
+        i3_workspaces->snapshot_save = g_timeout_add_seconds(SNAPSHOT_SAVE_DELAY,
+                save_snapshot, i3_workspaces);
+    }
+}
+
+/**
+ * button_is_current:
+ * @button: a workspace button
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Returns: whether the button has the parts create_workspace_button gives
+ * it with the current configuration
+ */
+static gboolean
+button_is_current(GtkWidget *button, i3WorkspacesPlugin *i3_workspaces)
+{
+    gboolean icons = g_object_get_data(G_OBJECT(button), "icons") != NULL;
+    gboolean tooltip = gtk_widget_get_has_tooltip(button);
+
+    return icons == i3_workspaces->config->show_app_icons &&
+        tooltip == (i3_workspaces->thumbnails || i3_workspaces->window_titles);
+}
+
+/**
+ * create_workspace_button:
+ * @i3_workspaces: the workspaces plugin
+ * @workspace: the workspace
+ *
+ * Create the button of the workspace and pack it after the others.
+ *
+ * Returns: the button
+ */
+static GtkWidget *
+create_workspace_button(i3WorkspacesPlugin *i3_workspaces, i3workspace *workspace)
+{
+    GtkWidget * button;
+    button = xfce_panel_create_button();
+    GtkStyleContext *context = gtk_widget_get_style_context(button);
+    gtk_style_context_add_class(context, "workspace");
+
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 2);
+    GtkWidget *label = gtk_label_new(NULL);
+    gtk_box_pack_start(GTK_BOX(box), label, FALSE, FALSE, 0);
+    g_object_set_data(G_OBJECT(button), "label", label);
+    g_object_set_data_full(G_OBJECT(button), "workspace-name",
+            g_strdup(workspace->name), g_free);
+
+    if (i3_workspaces->config->show_app_icons)
+    {
+        GtkWidget *icons = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 1);
+        gtk_box_pack_start(GTK_BOX(box), icons, FALSE, FALSE, 0);
+        g_object_set_data(G_OBJECT(button), "icons", icons);
+    }
+
+    gtk_container_add(GTK_CONTAINER(button), box);
+    gtk_widget_show_all(box);
+    i3w_css_apply(button, NULL, i3_workspaces->css_provider);
+    update_app_icons(button, workspace->name, i3_workspaces);
+
+    set_button_label(button, workspace, i3_workspaces);
+
+    g_signal_connect(G_OBJECT(button), "clicked",
+            G_CALLBACK(on_workspace_clicked), i3_workspaces);
+
+    if (i3_workspaces->thumbnails || i3_workspaces->window_titles)
+    {
+        gtk_widget_set_has_tooltip(button, TRUE);
+        g_signal_connect(G_OBJECT(button), "query-tooltip",
+                G_CALLBACK(on_workspace_query_tooltip), i3_workspaces);
+    }
+
+    /* show the panel's right-click menu on this button */
+    xfce_panel_plugin_add_action_widget(i3_workspaces->plugin, button);
+
+    gtk_box_pack_end(GTK_BOX(i3_workspaces->hvbox), button, FALSE, FALSE, 0);
+    gtk_widget_show(button);
+
+    i3w_stats_add(I3W_STAT_BUTTONS_CREATED, 1);
+    i3w_stats_add(I3W_STAT_LIVE_BUTTONS, 1);
+
+    return button;
+}
+
+/**
+ * remove_workspaces:
+ * @i3_workspaces: the workspaces plugin
  *
  * Remove all workspaces.
  */
 static void
 remove_workspaces(i3WorkspacesPlugin *i3_workspaces)
 {
+    gint64 trace = i3w_trace_begin();
     GList *wlist = g_hash_table_get_values(i3_workspaces->workspace_buttons);
+    gint removed = g_list_length(wlist);
+
     g_hash_table_remove_all(i3_workspaces->workspace_buttons);
     g_list_free_full(wlist, (GDestroyNotify) gtk_widget_destroy);
+
+    if (i3_workspaces->workspaces)
+        i3wm_unref_workspaces(i3_workspaces->workspaces);
+    i3_workspaces->workspaces = NULL;
+    i3_workspaces->rendered_generation = 0;
+
+    i3w_stats_add(I3W_STAT_BUTTONS_DESTROYED, removed);
+    i3w_stats_add(I3W_STAT_LIVE_BUTTONS, -removed);
+
+    i3w_trace_end("remove_workspaces", trace, NULL, removed);
+}
+
+/**
+ * load_snapshot:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Read the workspaces of the last session, stored next to the rc file.
+ */
+static void
+load_snapshot(i3WorkspacesPlugin *i3_workspaces)
+{
+    gchar *rc_file = xfce_panel_plugin_save_location(i3_workspaces->plugin, TRUE);
+    if (!rc_file)
+        return;
+
+    i3_workspaces->snapshot_path = g_strconcat(rc_file, ".snapshot", NULL);
+    g_free(rc_file);
+
+    if (g_file_get_contents(i3_workspaces->snapshot_path,
+                &i3_workspaces->snapshot_data, NULL, NULL))
+    {
+        i3_workspaces->snapshot = i3w_snapshot_parse(i3_workspaces->snapshot_data);
+    }
+}
+
+/**
+ * save_snapshot:
+ * @data: the workspaces plugin
+ *
+ * Store the current workspaces for the next session, unless they are the
+ * same as the stored ones.
+ *
+ * Returns: G_SOURCE_REMOVE
+ */
+static gboolean
+save_snapshot(gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+    GError *err = NULL;
+
+    i3_workspaces->snapshot_save = 0;
+    i3w_stats_add(I3W_STAT_TIMER_WAKEUPS, 1);
+
+    if (!i3_workspaces->i3wm || !i3_workspaces->snapshot_path)
+        return G_SOURCE_REMOVE;
+
+    gchar *snapshot = i3w_snapshot_serialize(i3wm_get_workspaces(i3_workspaces->i3wm));
+    if (g_strcmp0(snapshot, i3_workspaces->snapshot_data) == 0)
+    {
+        g_free(snapshot);
+        return G_SOURCE_REMOVE;
+    }
+
+    if (!g_file_set_contents(i3_workspaces->snapshot_path, snapshot, -1, &err))
+    {
+        fprintf(stderr, "Failed to save the workspace snapshot: %s\n", err->message);
+        g_error_free(err);
+    }
+
+    g_free(i3_workspaces->snapshot_data);
+    i3_workspaces->snapshot_data = snapshot;
+
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * drop_snapshot:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Free the workspaces read from the snapshot once the buttons no longer
+ * refer to them.
+ */
+static void
+drop_snapshot(i3WorkspacesPlugin *i3_workspaces)
+{
+    i3w_snapshot_free(i3_workspaces->snapshot);
+    i3_workspaces->snapshot = NULL;
 }
 
 /**
@@ -460,8 +1231,84 @@ on_workspace_changed(gpointer data)
 {
     i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
 
-    remove_workspaces(i3_workspaces);
+    if (i3_workspaces->hidden)
+    {
+        i3_workspaces->dirty = TRUE;
+        return;
+    }
+    i3_workspaces->dirty = FALSE;
+
+    I3W_PROBE1(ui_update_start, g_hash_table_size(i3_workspaces->workspace_buttons));
+    gint64 start = g_get_monotonic_time();
+
     add_workspaces(i3_workspaces);
+    reconcile_pending_focus(i3_workspaces);
+
+    I3W_PROBE1(ui_update_end, g_hash_table_size(i3_workspaces->workspace_buttons));
+    i3w_stats_record(I3W_TIMING_UI_UPDATE, start);
+
+    /* a workspace which just became visible has no thumbnail yet, one which
+     * was hidden must not get the next one's */
+    if (i3_workspaces->thumbnails)
+    {
+        GSList *witem;
+        for (witem = i3wm_get_workspaces(i3_workspaces->i3wm); witem != NULL; witem = witem->next)
+        {
+            i3workspace *workspace = (i3workspace *) witem->data;
+            if (!workspace->visible)
+                i3w_thumbnails_cancel(i3_workspaces->thumbnails, workspace->name);
+        }
+        i3w_thumbnails_invalidate(i3_workspaces->thumbnails);
+    }
+}
+
+/**
+ * on_workspace_windows_changed:
+ * @workspace: the name of the workspace
+ * @data: the workspaces plugin
+ *
+ * The applications on the workspace changed, only its icons are updated.
+ */
+static void
+on_workspace_windows_changed(const gchar *workspace, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+    GHashTableIter iter;
+    gpointer key, value;
+
+    if (i3_workspaces->hidden)
+    {
+        i3_workspaces->dirty = TRUE;
+        return;
+    }
+
+    g_hash_table_iter_init(&iter, i3_workspaces->workspace_buttons);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        i3workspace *ws = (i3workspace *) key;
+        if (g_strcmp0(ws->name, workspace) == 0)
+        {
+            update_app_icons(GTK_WIDGET(value), workspace, i3_workspaces);
+            break;
+        }
+    }
+}
+
+/**
+ * on_window_titles_changed:
+ * @workspace: (nullable): the name of the workspace, NULL if unknown
+ * @data: the workspaces plugin
+ *
+ * A window appeared, disappeared or was renamed, its titles are fetched
+ * again when a tooltip needs them.
+ */
+static void
+on_window_titles_changed(const gchar *workspace, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+
+    if (i3_workspaces->window_titles)
+        i3w_window_titles_invalidate(i3_workspaces->window_titles, workspace);
 }
 
 /**
@@ -475,6 +1322,14 @@ static void
 on_mode_changed(gchar *mode, gpointer data)
 {
     i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+
+    if (i3_workspaces->hidden)
+    {
+        g_free(i3_workspaces->pending_mode);
+        i3_workspaces->pending_mode = g_strdup(mode);
+        return;
+    }
+
 	if (!strncmp(mode, "default", 7)) {
 		gtk_label_set_text((GtkLabel *) i3_workspaces->mode_label, "");
     }
@@ -487,7 +1342,8 @@ on_mode_changed(gchar *mode, gpointer data)
  * handle_change_output:
  * @i3_workspaces: the workspaces plugin
  *
- * Recomputes the panel's output based on XRandR's current data.
+ * Recomputes the panel's output based on XRandR's current data and
+ * updates the buttons to its workspaces.
  * Does not run if auto_detect_outputs is set to false.
  */
 static void
@@ -496,8 +1352,12 @@ handle_change_output (i3WorkspacesPlugin* i3_workspaces)
 
     if(!i3_workspaces->config->auto_detect_outputs) return;
 
+    gint64 trace = i3w_trace_begin();
+
     // Re-query X Server for monitor information, since it may have changed
+    gint64 trace_outputs = i3w_trace_begin();
     i3_workspaces_outputs_t outputs = get_outputs();
+    i3w_trace_end("get_outputs", trace_outputs, NULL, -1);
 
     // Get the plugin's widget window and its location in root window (i.e: screen) coordinates
     int x, y;
@@ -505,13 +1365,17 @@ handle_change_output (i3WorkspacesPlugin* i3_workspaces)
     gdk_window_get_root_origin(window, &x, &y);
 
     // Get the monitor name for the window location and set the config value
-    char* output_name = get_monitor_name_at(outputs, x, y);
+    const char* output_name = get_monitor_name_at(outputs, x, y);
 
-    i3_workspaces->config->output = output_name;
-    remove_workspaces(i3_workspaces);
+    // the name belongs to the outputs structure
+    g_free(i3_workspaces->config->output);
+    i3_workspaces->config->output = g_strdup(output_name ? output_name : "");
     add_workspaces(i3_workspaces);
 
     free_outputs(outputs);
+
+    i3w_trace_end("handle_change_output", trace, i3_workspaces->config->output,
+            g_hash_table_size(i3_workspaces->workspace_buttons));
 }
 
 /**
@@ -525,22 +1389,66 @@ static void
 on_output_changed(gchar *mode, gpointer data)
 {
     i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+
+    if (i3_workspaces->hidden)
+    {
+        i3_workspaces->output_dirty = TRUE;
+        return;
+    }
     handle_change_output(i3_workspaces);
 }
 
+/**
+ * on_bar_config_changed:
+ * @data: the workspaces plugin
+ *
+ * The bar configuration was read again. The stylesheet is only regenerated
+ * and applied when the colors actually changed.
+ */
+static void
+on_bar_config_changed(gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+    GHashTable *colors = i3_workspaces->i3wm ?
+        i3wm_get_bar_colors(i3_workspaces->i3wm) : NULL;
+    gchar *css = colors ? i3w_bar_theme_css(colors) : NULL;
+
+    if (g_strcmp0(css, i3_workspaces->bar_css) == 0)
+    {
+        g_free(css);
+        return;
+    }
+
+    g_free(i3_workspaces->bar_css);
+    i3_workspaces->bar_css = css;
+
+    if (i3_workspaces->config->use_css || !i3_workspaces->config->use_bar_colors)
+        return;
+
+    init_css(i3_workspaces);
+
+    /* the widths depend on the style of the states */
+    if (i3_workspaces->label_widths)
+    {
+        init_stable_layout(i3_workspaces);
+        i3_workspaces->rendered_generation = 0;
+        on_workspace_changed(i3_workspaces);
+    }
+}
+
 
 /**
  * set_button_label:
  * @button: the button
- * @name: the workspace name
- * @focused: is the workspace focused?
- * @urgent: is the workspace urgent?
+ * @workspace: the workspace
+ * @i3_workspaces: the workspaces plugin
  *
- * Generate the label for the workspace button.
+ * Generate the label for the workspace button. The label is only touched
+ * when the rendered text differs from the current one.
  */
 static void
 set_button_label(GtkWidget *button, i3workspace *workspace,
-        i3WorkspacesConfig *config)
+        i3WorkspacesPlugin *i3_workspaces)
 {
     GtkStyleContext *context = gtk_widget_get_style_context(button);
 
@@ -552,44 +1460,411 @@ set_button_label(GtkWidget *button, i3workspace *workspace,
     if (workspace->visible) gtk_style_context_add_class(context, "visible");
     else gtk_style_context_remove_class(context, "visible");
 
-    gchar *name = (config->strip_workspace_numbers && workspace->num > 0) ?
-        strip_workspace_numbers(workspace->name, workspace->num) :
-        workspace->name;
+    GString *text = i3_workspaces->label_buffer;
+    i3w_label_format_render(i3_workspaces->label_format, workspace, text);
+
+    GtkWidget *label = GTK_WIDGET(g_object_get_data(G_OBJECT(button), "label"));
+    if (g_strcmp0(gtk_label_get_label(GTK_LABEL(label)), text->str) != 0)
+        gtk_label_set_markup(GTK_LABEL(label), text->str);
 
-    GtkWidget *label = gtk_bin_get_child(GTK_BIN(button));
-    gtk_label_set_text(GTK_LABEL(label), name);
+    if (i3_workspaces->label_widths)
+        set_stable_width(button, label, text->str, i3_workspaces);
 }
 
 /**
- * strip_workspace_numbers:
- * @workspaceName - the name of the workspace
- * @workspaceNum - the number of the workspace
+ * set_stable_width:
+ * @button: the button
+ * @label: the label of the button
+ * @markup: the markup of the label
+ * @i3_workspaces: the workspaces plugin
  *
- * Strips the workspace name of the workspace number.
- * Returns: an i3workspace*
+ * Reserve the width of the widest state of the button for the label, so
+ * the focus and urgency changes only repaint it. The font of each state is
+ * read from a saved style context, the width is cached per markup.
  */
-static gchar *
-strip_workspace_numbers(const gchar *name, int num)
+static void
+set_stable_width(GtkWidget *button, GtkWidget *label, const gchar *markup,
+        i3WorkspacesPlugin *i3_workspaces)
 {
-    size_t offset = 0;
-    offset += (num < 10) ? 1 : 2;
-    if (name[offset] == ':') offset++;
+    static const gchar *states[] = { "visible", "focused", "urgent" };
+    gpointer cached;
+    gint width = 0, current;
+    guint i, j;
 
-    int len = strlen(name);
-    gchar *strippedName = NULL;
-
-    if (offset < len)
+    if (g_hash_table_lookup_extended(i3_workspaces->label_widths, markup, NULL, &cached))
     {
-        int strippedLen = len - offset + 1;
-        strippedName = (gchar *) malloc(strippedLen);
-        strippedName = memcpy(strippedName, name + offset, strippedLen);
+        width = GPOINTER_TO_INT(cached);
     }
     else
     {
-        strippedName = strdup(name);
+        GtkStyleContext *context = gtk_widget_get_style_context(button);
+        PangoLayout *layout = gtk_widget_create_pango_layout(label, NULL);
+        pango_layout_set_markup(layout, markup, -1);
+
+        // no state class at all, then each of them alone
+        for (i = 0; i <= G_N_ELEMENTS(states); i++)
+        {
+            PangoFontDescription *font = NULL;
+            gint state_width;
+
+            gtk_style_context_save(context);
+            for (j = 0; j < G_N_ELEMENTS(states); j++)
+                gtk_style_context_remove_class(context, states[j]);
+            if (i < G_N_ELEMENTS(states))
+                gtk_style_context_add_class(context, states[i]);
+            gtk_style_context_get(context, gtk_style_context_get_state(context),
+                    GTK_STYLE_PROPERTY_FONT, &font, NULL);
+            gtk_style_context_restore(context);
+
+            pango_layout_set_font_description(layout, font);
+            pango_layout_get_pixel_size(layout, &state_width, NULL);
+            width = MAX(width, state_width);
+
+            pango_font_description_free(font);
+        }
+
+        g_object_unref(layout);
+        g_hash_table_insert(i3_workspaces->label_widths, g_strdup(markup),
+                GINT_TO_POINTER(width));
+    }
+
+    gtk_widget_get_size_request(label, &current, NULL);
+    if (current != width)
+        gtk_widget_set_size_request(label, width, -1);
+}
+
+/**
+ * update_urgent_animation:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Start pulsing the urgent buttons when there are any, stop when there are
+ * none, the animation is disabled or the panel is not shown. All the urgent
+ * buttons share a single tick callback on the frame clock, so the number of
+ * wakeups does not depend on the number of urgent workspaces.
+ */
+static void
+update_urgent_animation(i3WorkspacesPlugin *i3_workspaces)
+{
+    gboolean animate = FALSE;
+
+    if (i3_workspaces->config->animate_urgent && !i3_workspaces->hidden)
+    {
+        GHashTableIter iter;
+        gpointer key;
+
+        g_hash_table_iter_init(&iter, i3_workspaces->workspace_buttons);
+        while (!animate && g_hash_table_iter_next(&iter, &key, NULL))
+            animate = ((i3workspace *) key)->urgent;
+    }
+
+    if (animate && !i3_workspaces->urgent_tick)
+    {
+        i3_workspaces->urgent_tick = gtk_widget_add_tick_callback(i3_workspaces->hvbox,
+                on_urgent_tick, i3_workspaces, NULL);
+    }
+    else if (!animate && i3_workspaces->urgent_tick)
+    {
+        gtk_widget_remove_tick_callback(i3_workspaces->hvbox, i3_workspaces->urgent_tick);
+        i3_workspaces->urgent_tick = 0;
+        set_urgent_opacity(i3_workspaces, 1.0);
+    }
+}
+
+/**
+ * on_hvbox_mapped:
+ * @hvbox: the box of the buttons
+ * @data: the workspaces plugin
+ *
+ * The panel was shown or hidden.
+ */
+static void
+on_hvbox_mapped(GtkWidget *hvbox, gpointer data)
+{
+    update_visibility((i3WorkspacesPlugin *) data);
+}
+
+/**
+ * on_visibility_changed:
+ * @ebox: the plugin's event box
+ * @event: the event data
+ * @data: the workspaces plugin
+ *
+ * Without a compositor, X reports a panel covered by other windows or on a
+ * switched off monitor as fully obscured. Composited windows are never
+ * obscured, so this only supplements the state and the position of the
+ * panel window.
+ *
+ * Returns: FALSE to propagate the event
+ */
+static gboolean
+on_visibility_changed(GtkWidget *ebox, GdkEventVisibility *event, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+
+    i3_workspaces->obscured = event->state == GDK_VISIBILITY_FULLY_OBSCURED;
+    update_visibility(i3_workspaces);
+
+    return FALSE;
+}
+
+/**
+ * on_hierarchy_changed:
+ * @ebox: the plugin's event box
+ * @previous: the previous toplevel
+ * @data: the workspaces plugin
+ *
+ * The plugin was put into a panel window.
+ */
+static void
+on_hierarchy_changed(GtkWidget *ebox, GtkWidget *previous, gpointer data)
+{
+    watch_toplevel((i3WorkspacesPlugin *) data);
+}
+
+/**
+ * watch_toplevel:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Follow the state and the position of the panel window the plugin is in.
+ */
+static void
+watch_toplevel(i3WorkspacesPlugin *i3_workspaces)
+{
+    GtkWidget *toplevel = gtk_widget_get_toplevel(i3_workspaces->ebox);
+    if (!gtk_widget_is_toplevel(toplevel))
+        toplevel = NULL;
+
+    if (toplevel == i3_workspaces->toplevel)
+        return;
+
+    if (i3_workspaces->toplevel)
+    {
+        g_signal_handlers_disconnect_by_data(i3_workspaces->toplevel, i3_workspaces);
+        g_object_remove_weak_pointer(G_OBJECT(i3_workspaces->toplevel),
+                (gpointer *) &i3_workspaces->toplevel);
     }
 
-    return strippedName;
+    i3_workspaces->toplevel = toplevel;
+    i3_workspaces->toplevel_hidden = FALSE;
+
+    if (toplevel)
+    {
+        g_object_add_weak_pointer(G_OBJECT(toplevel), (gpointer *) &i3_workspaces->toplevel);
+        g_signal_connect(G_OBJECT(toplevel), "window-state-event",
+                G_CALLBACK(on_window_state_changed), i3_workspaces);
+        g_signal_connect(G_OBJECT(toplevel), "configure-event",
+                G_CALLBACK(on_toplevel_configured), i3_workspaces);
+    }
+
+    update_visibility(i3_workspaces);
+}
+
+/**
+ * on_window_state_changed:
+ * @toplevel: the panel window
+ * @event: the event data
+ * @data: the workspaces plugin
+ *
+ * A withdrawn or iconified panel window cannot be seen, whatever the
+ * compositor draws.
+ *
+ * Returns: FALSE to propagate the event
+ */
+static gboolean
+on_window_state_changed(GtkWidget *toplevel, GdkEventWindowState *event, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
+
+    i3_workspaces->toplevel_hidden = (event->new_window_state &
+            (GDK_WINDOW_STATE_WITHDRAWN | GDK_WINDOW_STATE_ICONIFIED)) != 0;
+    update_visibility(i3_workspaces);
+
+    return FALSE;
+}
+
+/**
+ * on_toplevel_configured:
+ * @toplevel: the panel window
+ * @event: the event data
+ * @data: the workspaces plugin
+ *
+ * An autohidden panel slides its window off the monitor.
+ *
+ * Returns: FALSE to propagate the event
+ */
+static gboolean
+on_toplevel_configured(GtkWidget *toplevel, GdkEventConfigure *event, gpointer data)
+{
+    update_visibility((i3WorkspacesPlugin *) data);
+
+    return FALSE;
+}
+
+/**
+ * is_off_monitor:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Returns: TRUE if the plugin lies outside of the monitor the panel is on
+ */
+static gboolean
+is_off_monitor(i3WorkspacesPlugin *i3_workspaces)
+{
+    GdkWindow *window = gtk_widget_get_window(i3_workspaces->ebox);
+    if (!window || !gtk_widget_get_mapped(i3_workspaces->ebox))
+        return FALSE;
+
+    GdkMonitor *monitor = gdk_display_get_monitor_at_window(
+            gdk_window_get_display(window), window);
+    if (!monitor)
+        return FALSE;
+
+    GdkRectangle area, geometry;
+    gdk_window_get_origin(window, &area.x, &area.y);
+    area.width = gtk_widget_get_allocated_width(i3_workspaces->ebox);
+    area.height = gtk_widget_get_allocated_height(i3_workspaces->ebox);
+    gdk_monitor_get_geometry(monitor, &geometry);
+
+    return !gdk_rectangle_intersect(&area, &geometry, NULL);
+}
+
+/**
+ * update_visibility:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Work out whether the buttons can be seen: the panel window must be shown
+ * and on its monitor, and X must not report it as fully obscured. Coming
+ * back into view, the changes missed while hidden are applied at once.
+ */
+static void
+update_visibility(i3WorkspacesPlugin *i3_workspaces)
+{
+    gboolean hidden = !gtk_widget_get_mapped(i3_workspaces->hvbox) ||
+        i3_workspaces->toplevel_hidden ||
+        is_off_monitor(i3_workspaces) ||
+        i3_workspaces->obscured;
+
+    if (hidden == i3_workspaces->hidden)
+        return;
+
+    i3_workspaces->hidden = hidden;
+
+    if (!hidden)
+    {
+        if (i3_workspaces->pending_mode)
+        {
+            gchar *mode = i3_workspaces->pending_mode;
+            i3_workspaces->pending_mode = NULL;
+            on_mode_changed(mode, i3_workspaces);
+            g_free(mode);
+        }
+
+        if (i3_workspaces->output_dirty && i3_workspaces->config->auto_detect_outputs)
+        {
+            // updates the buttons too
+            handle_change_output(i3_workspaces);
+            i3_workspaces->dirty = FALSE;
+        }
+        i3_workspaces->output_dirty = FALSE;
+
+        if (i3_workspaces->dirty)
+            on_workspace_changed(i3_workspaces);
+    }
+
+    update_urgent_animation(i3_workspaces);
+}
+
+/**
+ * on_urgent_tick:
+ * @hvbox: the box of the buttons
+ * @clock: the frame clock
+ * @data: the workspaces plugin
+ *
+ * Fade the urgent buttons in and out, in a triangle wave.
+ *
+ * Returns: G_SOURCE_CONTINUE
+ */
+static gboolean
+on_urgent_tick(GtkWidget *hvbox, GdkFrameClock *clock, gpointer data)
+{
+    gint64 phase = gdk_frame_clock_get_frame_time(clock) % URGENT_PULSE_PERIOD;
+    gdouble x = (gdouble) phase / URGENT_PULSE_PERIOD;
+    gdouble wave = x < 0.5 ? 1.0 - 2.0 * x : 2.0 * x - 1.0;
+
+    set_urgent_opacity((i3WorkspacesPlugin *) data,
+            URGENT_PULSE_MIN_OPACITY + (1.0 - URGENT_PULSE_MIN_OPACITY) * wave);
+
+    return G_SOURCE_CONTINUE;
+}
+
+/**
+ * set_urgent_opacity:
+ * @i3_workspaces: the workspaces plugin
+ * @opacity: the opacity of the urgent buttons
+ *
+ * The other buttons are kept opaque.
+ */
+static void
+set_urgent_opacity(i3WorkspacesPlugin *i3_workspaces, gdouble opacity)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_hash_table_iter_init(&iter, i3_workspaces->workspace_buttons);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        i3workspace *workspace = (i3workspace *) key;
+        gtk_widget_set_opacity(GTK_WIDGET(value), workspace->urgent ? opacity : 1.0);
+    }
+}
+
+/**
+ * update_app_icons:
+ * @button: the button
+ * @workspace: the workspace name
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Show one icon for each application on the workspace. The icons are only
+ * built again when the applications differ from the ones shown.
+ */
+static void
+update_app_icons(GtkWidget *button, const gchar *workspace,
+        i3WorkspacesPlugin *i3_workspaces)
+{
+    GtkWidget *icons = GTK_WIDGET(g_object_get_data(G_OBJECT(button), "icons"));
+    if (!icons || !i3_workspaces->i3wm)
+        return;
+
+    GList *apps = i3wm_get_workspace_apps(i3_workspaces->i3wm, workspace);
+    GList *aitem;
+
+    /* the classes, sorted and joined, of the icons shown */
+    GString *shown = g_string_new(NULL);
+    for (aitem = apps; aitem != NULL; aitem = aitem->next)
+    {
+        g_string_append(shown, (const gchar *) aitem->data);
+        g_string_append_c(shown, '\n');
+    }
+
+    if (g_strcmp0(g_object_get_data(G_OBJECT(button), "apps"), shown->str) == 0)
+    {
+        g_string_free(shown, TRUE);
+        g_list_free(apps);
+        return;
+    }
+    g_object_set_data_full(G_OBJECT(button), "apps", g_string_free(shown, FALSE), g_free);
+
+    gtk_container_foreach(GTK_CONTAINER(icons), (GtkCallback) gtk_widget_destroy, NULL);
+
+    for (aitem = apps; aitem != NULL; aitem = aitem->next)
+    {
+        GtkWidget *image = gtk_image_new();
+        i3w_icon_cache_set_image(GTK_IMAGE(image), (const gchar *) aitem->data,
+                APP_ICON_SIZE);
+        gtk_box_pack_start(GTK_BOX(icons), image, FALSE, FALSE, 0);
+        gtk_widget_show(image);
+        i3w_css_apply(image, NULL, i3_workspaces->css_provider);
+    }
+    g_list_free(apps);
 }
 
 /**
@@ -597,34 +1872,175 @@ strip_workspace_numbers(const gchar *name, int num)
  * @button: the clicked button
  * @data: the workspace plugin
  *
- * Workspace button click event handler.
+ * Workspace button click event handler. The button is shown focused right
+ * away, the command is only sent once the new highlight has been drawn.
  */
 static void
 on_workspace_clicked(GtkWidget *button, gpointer data)
 {
     i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *)data;
-    GSList *wlist, *witem;
-    i3workspace *workspace = NULL;
+    const gchar *name = g_object_get_data(G_OBJECT(button), "workspace-name");
 
-    if (!i3_workspaces->i3wm) {
+    if (!i3_workspaces->i3wm || !name) {
         return;
     }
 
-    wlist = i3wm_get_workspaces(i3_workspaces->i3wm);
-    for (witem = wlist; witem != NULL; witem = witem->next)
+    clear_pending_focus(i3_workspaces);
+    i3_workspaces->pending_focus = g_strdup(name);
+    i3_workspaces->pending_focus_clicked = g_get_monotonic_time();
+    show_focus(i3_workspaces, name);
+
+    i3_workspaces->pending_focus_idle = g_idle_add_full(G_PRIORITY_LOW,
+            send_pending_focus, i3_workspaces, NULL);
+    i3_workspaces->pending_focus_timeout = g_timeout_add(PENDING_FOCUS_TIMEOUT,
+            on_pending_focus_timeout, i3_workspaces);
+}
+
+/**
+ * send_pending_focus:
+ * @data: the workspace plugin
+ *
+ * Send the command for the clicked workspace, after the redraw since it is
+ * of lower priority. The highlight is rolled back if it fails.
+ *
+ * Returns: G_SOURCE_REMOVE
+ */
+static gboolean
+send_pending_focus(gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *)data;
+    GError *err = NULL;
+
+    i3_workspaces->pending_focus_idle = 0;
+
+    if (i3_workspaces->i3wm)
+        i3wm_goto_workspace(i3_workspaces->i3wm, i3_workspaces->pending_focus, &err);
+
+    if (err != NULL || !i3_workspaces->i3wm)
     {
-        workspace = (i3workspace *) witem->data;
-        GtkWidget *w = (GtkWidget *) g_hash_table_lookup(i3_workspaces->workspace_buttons, workspace);
+        if (err != NULL)
+        {
+            fprintf(stderr, "%s\n", err->message);
+            g_error_free(err);
+        }
+        clear_pending_focus(i3_workspaces);
+        show_focus(i3_workspaces, NULL);
+        return G_SOURCE_REMOVE;
+    }
+
+    i3_workspaces->pending_focus_sent = TRUE;
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * on_pending_focus_timeout:
+ * @data: the workspace plugin
+ *
+ * i3 did not confirm the clicked workspace in time, show the actual focus.
+ *
+ * Returns: G_SOURCE_REMOVE
+ */
+static gboolean
+on_pending_focus_timeout(gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *)data;
+
+    i3_workspaces->pending_focus_timeout = 0;
+    i3w_stats_add(I3W_STAT_TIMER_WAKEUPS, 1);
+    clear_pending_focus(i3_workspaces);
+    show_focus(i3_workspaces, NULL);
+
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * reconcile_pending_focus:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * The buttons were rebuilt from the workspaces of i3. The clicked workspace
+ * is confirmed once i3 reports it focused. Until the command is sent, the
+ * rebuild cannot know about it and the highlight is put back; after that a
+ * different focus means another switch won and the pending one is dropped.
+ */
+static void
+reconcile_pending_focus(i3WorkspacesPlugin *i3_workspaces)
+{
+    GSList *witem;
+
+    if (!i3_workspaces->pending_focus || !i3_workspaces->i3wm)
+        return;
 
-        if (w == button)
+    for (witem = i3wm_get_workspaces(i3_workspaces->i3wm); witem != NULL; witem = witem->next)
+    {
+        i3workspace *workspace = (i3workspace *) witem->data;
+        if (workspace->focused)
+        {
+            if (g_strcmp0(workspace->name, i3_workspaces->pending_focus) == 0)
+            {
+                /* the buttons are already restyled by now */
+                i3w_stats_record(I3W_TIMING_CLICK_TO_FOCUS,
+                        i3_workspaces->pending_focus_clicked);
+                clear_pending_focus(i3_workspaces);
+                return;
+            }
             break;
+        }
     }
 
-    GError *err = NULL;
-    i3wm_goto_workspace(i3_workspaces->i3wm, workspace, &err);
-    if (err != NULL)
+    if (i3_workspaces->pending_focus_sent)
+        clear_pending_focus(i3_workspaces);
+    else
+        show_focus(i3_workspaces, i3_workspaces->pending_focus);
+}
+
+/**
+ * clear_pending_focus:
+ * @i3_workspaces: the workspaces plugin
+ *
+ * Forget the clicked workspace, the buttons are left alone.
+ */
+static void
+clear_pending_focus(i3WorkspacesPlugin *i3_workspaces)
+{
+    if (i3_workspaces->pending_focus_idle)
+        g_source_remove(i3_workspaces->pending_focus_idle);
+    if (i3_workspaces->pending_focus_timeout)
+        g_source_remove(i3_workspaces->pending_focus_timeout);
+
+    i3_workspaces->pending_focus_idle = 0;
+    i3_workspaces->pending_focus_timeout = 0;
+    i3_workspaces->pending_focus_sent = FALSE;
+
+    g_free(i3_workspaces->pending_focus);
+    i3_workspaces->pending_focus = NULL;
+}
+
+/**
+ * show_focus:
+ * @i3_workspaces: the workspaces plugin
+ * @workspace: (nullable): the name of the workspace to show focused, NULL
+ * for the one focused according to i3
+ *
+ * Move the focused class between the buttons.
+ */
+static void
+show_focus(i3WorkspacesPlugin *i3_workspaces, const gchar *workspace)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+
+    /* the classes no longer match the rendered workspaces */
+    i3_workspaces->rendered_generation = 0;
+
+    g_hash_table_iter_init(&iter, i3_workspaces->workspace_buttons);
+    while (g_hash_table_iter_next(&iter, &key, &value))
     {
-        fprintf(stderr, "%s", err->message);
+        i3workspace *ws = (i3workspace *) key;
+        GtkStyleContext *context = gtk_widget_get_style_context(GTK_WIDGET(value));
+        gboolean focused = workspace ? g_strcmp0(ws->name, workspace) == 0 : ws->focused;
+
+        if (focused) gtk_style_context_add_class(context, "focused");
+        else gtk_style_context_remove_class(context, "focused");
     }
 }
 
@@ -678,7 +2094,7 @@ on_workspace_scrolled(GtkWidget *ebox, GdkEventScroll *ev, gpointer data)
     workspace = (i3workspace *) witem->data;
 
     GError *err = NULL;
-    i3wm_goto_workspace(i3_workspaces->i3wm, workspace, &err);
+    i3wm_goto_workspace(i3_workspaces->i3wm, workspace->name, &err);
     if (err != NULL)
     {
         fprintf(stderr, "%s", err->message);
@@ -686,6 +2102,49 @@ on_workspace_scrolled(GtkWidget *ebox, GdkEventScroll *ev, gpointer data)
     return TRUE;
 }
 
+/**
+ * on_workspace_query_tooltip:
+ * @button: the workspace button
+ * @x: the x coordinate of the pointer
+ * @y: the y coordinate of the pointer
+ * @keyboard_mode: whether the tooltip was triggered from the keyboard
+ * @tooltip: the tooltip
+ * @data: the workspace plugin
+ *
+ * Show the thumbnail of the workspace and the titles of its windows as the
+ * tooltip of its button. Titles not cached yet are fetched in the background
+ * and the tooltip is queried again when they arrive.
+ *
+ * Returns: TRUE if there is a thumbnail or a title to show
+ */
+static gboolean
+on_workspace_query_tooltip(GtkWidget *button, gint x, gint y,
+        gboolean keyboard_mode, GtkTooltip *tooltip, gpointer data)
+{
+    i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *)data;
+    const gchar *name = g_object_get_data(G_OBJECT(button), "workspace-name");
+
+    GdkPixbuf *pixbuf = NULL;
+    const gchar *titles = NULL;
+
+    if (!name)
+        return FALSE;
+
+    if (i3_workspaces->thumbnails)
+        pixbuf = i3w_thumbnails_lookup(i3_workspaces->thumbnails, name);
+    if (i3_workspaces->window_titles)
+        titles = i3w_window_titles_lookup(i3_workspaces->window_titles, name);
+
+    if (!pixbuf && (!titles || !titles[0]))
+        return FALSE;
+
+    if (pixbuf)
+        gtk_tooltip_set_icon(tooltip, pixbuf);
+    if (titles && titles[0])
+        gtk_tooltip_set_markup(tooltip, titles);
+    return TRUE;
+}
+
 static void
 on_ipc_shutdown(gpointer i3_w)
 {
@@ -694,6 +2153,9 @@ on_ipc_shutdown(gpointer i3_w)
 
     /* Remove previous resources */
     remove_workspaces(i3_workspaces);
+    update_urgent_animation(i3_workspaces);
+    if (i3_workspaces->window_titles)
+        i3w_window_titles_invalidate(i3_workspaces->window_titles, NULL);
     if (i3_workspaces->i3wm) {
         i3wm_destruct(i3_workspaces->i3wm);
         i3_workspaces->i3wm = NULL;
@@ -709,6 +2171,10 @@ reconnect_i3wm_callback(gpointer data)
     i3WorkspacesPlugin *i3_workspaces = (i3WorkspacesPlugin *) data;
     GError *err = NULL;
 
+    i3_workspaces->timeout = 0;
+    i3w_stats_add(I3W_STAT_TIMER_WAKEUPS, 1);
+    i3w_stats_add(I3W_STAT_RECONNECT_ATTEMPTS, 1);
+
     if (i3_workspaces->i3wm) {
         // maybe already initialized by other timers?
         fprintf(stderr, "warn: other timer already reconnected?\n");
@@ -716,27 +2182,39 @@ reconnect_i3wm_callback(gpointer data)
     }
 
     fprintf(stderr, "Connecting to i3 workspace manager...\n");
-    i3_workspaces->i3wm = i3wm_construct(&err);
+    i3_workspaces->i3wm = i3wm_construct(event_source(i3_workspaces->config), &err);
     if (err != NULL) {
         fprintf(stderr, "Still waiting for i3 window manager: %s\n",
                 err->message);
+
+        /* back off while i3 is away, the helper is up in a moment though */
+        if (!g_error_matches(err, G_IO_ERROR, G_IO_ERROR_PENDING))
+            i3_workspaces->reconnect_delay = MIN(i3_workspaces->reconnect_delay * 2,
+                    RECONNECT_MAX_DELAY);
         g_error_free(err);
-        return G_SOURCE_CONTINUE;
+
+        i3_workspaces->timeout = g_timeout_add_seconds(i3_workspaces->reconnect_delay,
+                reconnect_i3wm_callback, i3_workspaces);
+        return G_SOURCE_REMOVE;
     }
 
     // connected, doing the init things; todo: is memory barrier needed?
     //   don't know whether the timer is sync or not
     connect_callbacks(i3_workspaces);
+    update_delegate_features(i3_workspaces);
     add_workspaces(i3_workspaces);
+    drop_snapshot(i3_workspaces);
 
-    i3_workspaces->timeout = 0;
     return G_SOURCE_REMOVE;
 }
 
 static void
 reconnect_i3wm_timer(i3WorkspacesPlugin *i3_workspaces)
 {
-    guint id = g_timeout_add_seconds(1, reconnect_i3wm_callback, i3_workspaces);
+    i3_workspaces->reconnect_delay = RECONNECT_MIN_DELAY;
+
+    guint id = g_timeout_add_seconds(i3_workspaces->reconnect_delay,
+            reconnect_i3wm_callback, i3_workspaces);
     if (id == 0) {
         fprintf(stderr, "Timer broken! Plugin will no longer works.\n");
     }
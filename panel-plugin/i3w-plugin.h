@@ -22,6 +22,9 @@
 #include "i3wm-delegate.h"
 #include "i3w-multi-monitor-utils.h"
 #include "i3w-config.h"
+#include "i3w-label-format.h"
+#include "i3w-thumbnails.h"
+#include "i3w-window-titles.h"
 
 G_BEGIN_DECLS
 
@@ -31,6 +34,8 @@ typedef struct
     XfcePanelPlugin *plugin;
 
     GtkCssProvider *css_provider;
+    // stylesheet generated from the colors of the i3 bar, NULL until known
+    gchar           *bar_css;
 
     /* panel widgets */
     GtkWidget       *ebox;
@@ -38,14 +43,70 @@ typedef struct
 
     // hash table of i3workspace * => GtkButton *
     GHashTable      *workspace_buttons;
+    // the snapshot the keys of workspace_buttons belong to, NULL while the
+    // buttons come from the file snapshot, and the generation of the
+    // snapshot all the labels are rendered from, 0 when they are stale
+    i3wmWorkspaces  *workspaces;
+    guint64         rendered_generation;
 
 	// binding mode label
 	GtkWidget       *mode_label;
 
     i3WorkspacesConfig *config;
 
+    // compiled label template and the buffer it is rendered into
+    i3wLabelFormat  *label_format;
+    GString         *label_buffer;
+
+    // workspace thumbnails, NULL when disabled
+    i3wThumbnails   *thumbnails;
+
+    // window titles of the tooltips, NULL when disabled
+    i3wWindowTitles *window_titles;
+
+    // label markup => the widest width of its button states, NULL unless
+    // the stable layout is enabled
+    GHashTable      *label_widths;
+
+    // names of the workspaces always shown, with the stand-ins of the ones
+    // i3 does not have, owned here until the next add
+    gchar           **pinned;
+    GSList          *placeholders;
+
+    // the plugin is unmapped or off screen: events only mark the buttons
+    // dirty and the binding mode pending, applied once shown again
+    gboolean        hidden;
+    gboolean        obscured;
+    // the panel window, watched for being withdrawn, iconified or moved
+    GtkWidget       *toplevel;
+    gboolean        toplevel_hidden;
+    gboolean        dirty;
+    gboolean        output_dirty;
+    gchar           *pending_mode;
+
+    // tick callback pulsing the urgent buttons, 0 when not running
+    guint           urgent_tick;
+
+    // last known workspaces, shown until the first list from i3 arrives,
+    // with the file they are stored in, its contents and the pending write
+    GSList          *snapshot;
+    gchar           *snapshot_path;
+    gchar           *snapshot_data;
+    guint           snapshot_save;
+
+    // workspace clicked but not yet confirmed focused by i3, with the idle
+    // sending the command and the timeout rolling the highlight back
+    gchar           *pending_focus;
+    gboolean        pending_focus_sent;
+    guint           pending_focus_idle;
+    guint           pending_focus_timeout;
+    // when the pending workspace was clicked, for the click to focus latency
+    gint64          pending_focus_clicked;
+
     i3windowManager *i3wm;
     guint timeout;
+    // seconds until the next connection attempt, doubled after each failure
+    guint reconnect_delay;
 }
 i3WorkspacesPlugin;
 
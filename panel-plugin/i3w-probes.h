@@ -0,0 +1,45 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_PROBES_H__
+#define __I3W_PROBES_H__
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/*
+ * Static tracepoints (USDT) for perf and bpftrace, e.g.:
+ *
+ *   bpftrace -e 'usdt:libi3workspaces.so:i3workspaces:ui_update_end { ... }'
+ *
+ * Built with --enable-usdt a probe is a single nop until a tracer attaches,
+ * otherwise the macros expand to nothing and the arguments are not evaluated.
+ */
+
+#ifdef ENABLE_USDT
+#include <sys/sdt.h>
+
+#define I3W_PROBE1(name, a) DTRACE_PROBE1(i3workspaces, name, a)
+#define I3W_PROBE2(name, a, b) DTRACE_PROBE2(i3workspaces, name, a, b)
+#else
+#define I3W_PROBE1(name, a) do { } while (0)
+#define I3W_PROBE2(name, a, b) do { } while (0)
+#endif
+
+#endif /* !__I3W_PROBES_H__ */
@@ -0,0 +1,681 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include <gio/gio.h>
+#include <glib-unix.h>
+
+#include "i3w-ipc-socket.h"
+#include "i3w-shm.h"
+
+#define SHM_MAGIC 0x69337773
+#define SHM_VERSION 2
+
+// how often the watch thread makes sure the helper is still there, only
+// when its exit cannot be watched with a pidfd: one wakeup per second and
+// panel for as long as the panel runs
+#define WATCH_TIMEOUT_MS 1000
+// how often closing wakes the watch thread until it is done
+#define CLOSE_RETRY_US 1000
+// seqlock retries before suspecting the helper died while writing
+#define READ_RETRIES 1000
+
+typedef struct _i3w_shm_region
+{
+    guint32 magic;
+    guint32 version;
+    gint32 pid;
+    // cleared by the helper when it exits
+    gint alive;
+    // odd while the helper writes the model
+    gint seq;
+    // bumped after every write, the futex word the readers wait on
+    gint generation;
+    i3wShmModel model;
+} i3wShmRegion;
+
+struct _i3w_shm
+{
+    gint ref_count;
+
+    gchar *name;
+    gint fd;
+    gboolean helper;
+    i3wShmRegion *region;
+
+    GThread *watch_thread;
+    // the exit of the helper, -1 when pidfds are not available
+    gint pidfd;
+    guint pidfd_watch;
+    gint helper_gone;
+    gint closing;
+    gint watch_done;
+    gint watch_seen;
+    gint wakeup_pending;
+    i3wShmCallback callback;
+    gpointer data;
+};
+
+/*
+ * Prototypes
+ */
+static i3wShm *
+shm_map(const gchar *name, gboolean helper, GError **err);
+static void
+shm_unref(i3wShm *shm);
+static gboolean
+shm_unref_idle(gpointer data);
+static gboolean
+helper_alive(i3wShm *shm);
+static gint
+open_pidfd(gint pid);
+static gboolean
+on_helper_exited(gint fd, GIOCondition condition, gpointer data);
+static gpointer
+watch_thread(gpointer data);
+static gboolean
+notify_change(gpointer data);
+static void
+futex_wait(gint *word, gint value, gint timeout_ms);
+static void
+futex_wake(gint *word);
+
+/*
+ * Implementations of public functions
+ */
+
+/**
+ * i3w_shm_name:
+ * @socket_path: the i3 IPC socket path
+ *
+ * One region per user and i3 instance.
+ *
+ * Returns: the name of the shared memory object, free with g_free()
+ */
+gchar *
+i3w_shm_name(const gchar *socket_path)
+{
+    return g_strdup_printf("/xfce4-i3-workspaces-%u-%08x",
+            (guint) getuid(), g_str_hash(socket_path));
+}
+
+/**
+ * i3w_shm_model_add_workspace_name:
+ * @model: the model being built
+ * @workspace: the workspace of the model
+ * @name: the name of the workspace
+ *
+ * Store the name of the workspace in the name area of the model.
+ *
+ * Returns: FALSE if the area is full
+ */
+gboolean
+i3w_shm_model_add_workspace_name(i3wShmModel *model, i3wShmWorkspace *workspace,
+        const gchar *name)
+{
+    gsize len = strlen(name) + 1;
+
+    if (len > sizeof(model->names) - model->names_len)
+        return FALSE;
+
+    memcpy(model->names + model->names_len, name, len);
+    workspace->name = model->names_len;
+    model->names_len += len;
+
+    return TRUE;
+}
+
+/**
+ * i3w_shm_model_workspace_name:
+ * @model: the model
+ * @workspace: the workspace of the model
+ *
+ * Returns: the name of the workspace, owned by the model
+ */
+const gchar *
+i3w_shm_model_workspace_name(const i3wShmModel *model, const i3wShmWorkspace *workspace)
+{
+    // a model copied from a corrupt region must not send readers astray
+    if (workspace->name >= MIN(model->names_len, sizeof(model->names)) ||
+        !memchr(model->names + workspace->name, 0, sizeof(model->names) - workspace->name))
+        return "";
+
+    return model->names + workspace->name;
+}
+
+/**
+ * i3w_shm_model_load_workspaces:
+ * @model: the model to fill in
+ * @array: the reply to GET_WORKSPACES
+ *
+ * Replace the workspaces of the model. Workspaces beyond
+ * I3W_SHM_WORKSPACES_MAX or the name area of the model are left out, output
+ * names are truncated.
+ */
+void
+i3w_shm_model_load_workspaces(i3wShmModel *model, JsonArray *array)
+{
+    guint i;
+
+    model->n_workspaces = 0;
+    model->names_len = 0;
+    for (i = 0; i < json_array_get_length(array) && i < I3W_SHM_WORKSPACES_MAX; i++)
+    {
+        JsonObject *object = json_array_get_object_element(array, i);
+        i3wShmWorkspace *workspace = &model->workspaces[model->n_workspaces];
+
+        if (!i3w_shm_model_add_workspace_name(model, workspace,
+                    i3w_ipc_json_string(object, "name")))
+            break;
+        model->n_workspaces++;
+
+        workspace->num = json_object_get_int_member(object, "num");
+        workspace->flags = 0;
+        if (json_object_get_boolean_member(object, "focused"))
+            workspace->flags |= I3W_SHM_FOCUSED;
+        if (json_object_get_boolean_member(object, "visible"))
+            workspace->flags |= I3W_SHM_VISIBLE;
+        if (json_object_get_boolean_member(object, "urgent"))
+            workspace->flags |= I3W_SHM_URGENT;
+        g_strlcpy(workspace->output, i3w_ipc_json_string(object, "output"),
+                sizeof(workspace->output));
+    }
+}
+
+/**
+ * i3w_shm_create:
+ * @name: the name of the shared memory object
+ * @err: the error object
+ *
+ * Create the region as the helper. Only one helper may publish into a
+ * region, if another one already does this fails with G_IO_ERROR_EXISTS.
+ *
+ * Returns: the region or NULL on error
+ */
+i3wShm *
+i3w_shm_create(const gchar *name, GError **err)
+{
+    i3wShm *shm = shm_map(name, TRUE, err);
+    if (!shm)
+        return NULL;
+
+    i3wShmRegion *region = shm->region;
+
+    // a previous helper may have died in the middle of a write
+    if (g_atomic_int_get(&region->seq) & 1)
+        g_atomic_int_inc(&region->seq);
+
+    region->magic = SHM_MAGIC;
+    region->version = SHM_VERSION;
+    region->pid = getpid();
+    g_atomic_int_set(&region->alive, TRUE);
+
+    return shm;
+}
+
+/**
+ * i3w_shm_publish:
+ * @shm: the region
+ * @model: the new model
+ *
+ * Publish a new model and wake the readers.
+ */
+void
+i3w_shm_publish(i3wShm *shm, const i3wShmModel *model)
+{
+    i3wShmRegion *region = shm->region;
+
+    g_atomic_int_inc(&region->seq);
+    __sync_synchronize();
+    memcpy(&region->model, model, sizeof(*model));
+    __sync_synchronize();
+    g_atomic_int_inc(&region->seq);
+
+    g_atomic_int_inc(&region->generation);
+    futex_wake(&region->generation);
+}
+
+/**
+ * i3w_shm_destroy:
+ * @shm: the region
+ *
+ * Tell the readers the helper is gone and remove the region.
+ */
+void
+i3w_shm_destroy(i3wShm *shm)
+{
+    g_atomic_int_set(&shm->region->alive, FALSE);
+    g_atomic_int_inc(&shm->region->generation);
+    futex_wake(&shm->region->generation);
+
+    shm_unlink(shm->name);
+    shm_unref(shm);
+}
+
+/**
+ * i3w_shm_open:
+ * @name: the name of the shared memory object
+ * @err: the error object
+ *
+ * Map the region of a running helper read only. Fails with
+ * G_IO_ERROR_NOT_FOUND when there is no helper.
+ *
+ * Returns: the region or NULL on error
+ */
+i3wShm *
+i3w_shm_open(const gchar *name, GError **err)
+{
+    i3wShm *shm = shm_map(name, FALSE, err);
+    if (!shm)
+        return NULL;
+
+    if (shm->region->magic != SHM_MAGIC || shm->region->version != SHM_VERSION ||
+        !helper_alive(shm))
+    {
+        g_set_error(err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                "The workspace helper is not running");
+        shm_unref(shm);
+        return NULL;
+    }
+
+    return shm;
+}
+
+/**
+ * i3w_shm_read:
+ * @shm: the region
+ * @model: the model to copy to
+ * @generation: (nullable): return location for the generation of the copy,
+ * to start watching from
+ *
+ * Take a consistent copy of the model. No system calls are made unless the
+ * helper keeps the region locked for suspiciously long.
+ *
+ * Returns: FALSE if the helper has gone away
+ */
+gboolean
+i3w_shm_read(i3wShm *shm, i3wShmModel *model, gint *generation)
+{
+    i3wShmRegion *region = shm->region;
+    guint retries = 0;
+
+    for (;;)
+    {
+        // bumped after the write, so the copy is at least this recent and a
+        // publish racing with it is seen as a change
+        gint copied = g_atomic_int_get(&region->generation);
+        gint seq = g_atomic_int_get(&region->seq);
+
+        if (generation)
+            *generation = copied;
+
+        if (!(seq & 1))
+        {
+            __sync_synchronize();
+            memcpy(model, &region->model, sizeof(*model));
+            __sync_synchronize();
+
+            if (g_atomic_int_get(&region->seq) == seq)
+                break;
+        }
+
+        if (++retries % READ_RETRIES == 0 && !helper_alive(shm))
+            return FALSE;
+    }
+
+    return g_atomic_int_get(&region->alive) && !g_atomic_int_get(&shm->helper_gone);
+}
+
+/**
+ * i3w_shm_watch:
+ * @shm: the region
+ * @generation: the generation of the model already read, see i3w_shm_read()
+ * @callback: the callback
+ * @data: the data to be passed to the callback function
+ *
+ * Start a thread waiting for changes of the model since @generation. The
+ * callback runs on the main loop, once for any number of changes since its
+ * last call, and also when the helper goes away. The exit of the helper is watched with a pidfd
+ * on the main loop, so nothing wakes up while the model does not change.
+ * Without pidfds the thread checks on the helper every WATCH_TIMEOUT_MS.
+ */
+void
+i3w_shm_watch(i3wShm *shm, gint generation, i3wShmCallback callback, gpointer data)
+{
+    g_return_if_fail(!shm->watch_thread);
+
+    shm->callback = callback;
+    shm->data = data;
+    shm->watch_seen = generation;
+
+    shm->pidfd = open_pidfd(shm->region->pid);
+    if (shm->pidfd >= 0)
+        shm->pidfd_watch = g_unix_fd_add(shm->pidfd, G_IO_IN | G_IO_HUP | G_IO_ERR,
+                on_helper_exited, shm);
+
+    g_atomic_int_inc(&shm->ref_count);
+    shm->watch_thread = g_thread_new("i3w-shm-watch", watch_thread, shm);
+}
+
+/**
+ * i3w_shm_close:
+ * @shm: the region
+ *
+ * Stop watching and unmap the region. The thread may be between its check
+ * of closing and the wait, where a single wake is lost, so it is woken
+ * until it is done.
+ */
+void
+i3w_shm_close(i3wShm *shm)
+{
+    g_atomic_int_set(&shm->closing, TRUE);
+
+    if (shm->watch_thread)
+    {
+        while (!g_atomic_int_get(&shm->watch_done))
+        {
+            futex_wake(&shm->region->generation);
+            g_usleep(CLOSE_RETRY_US);
+        }
+        g_thread_join(shm->watch_thread);
+    }
+
+    if (shm->pidfd_watch)
+        g_source_remove(shm->pidfd_watch);
+    if (shm->pidfd >= 0)
+        close(shm->pidfd);
+
+    shm_unref(shm);
+}
+
+/*
+ * Implementations of private functions
+ */
+
+/**
+ * shm_map:
+ * @name: the name of the shared memory object
+ * @helper: whether to map the region as the helper
+ * @err: the error object
+ *
+ * Returns: the mapped region or NULL on error
+ */
+static i3wShm *
+shm_map(const gchar *name, gboolean helper, GError **err)
+{
+    gint fd = shm_open(name, helper ? O_RDWR | O_CREAT : O_RDONLY, 0600);
+    if (fd < 0)
+    {
+        gint code = errno;
+        g_set_error(err, G_IO_ERROR, g_io_error_from_errno(code),
+                "Failed to open %s: %s", name, g_strerror(code));
+        return NULL;
+    }
+
+    if (helper)
+    {
+        if (flock(fd, LOCK_EX | LOCK_NB) < 0)
+        {
+            g_set_error(err, G_IO_ERROR, G_IO_ERROR_EXISTS,
+                    "Another helper publishes into %s", name);
+            close(fd);
+            return NULL;
+        }
+
+        if (ftruncate(fd, sizeof(i3wShmRegion)) < 0)
+        {
+            gint code = errno;
+            g_set_error(err, G_IO_ERROR, g_io_error_from_errno(code),
+                    "Failed to size %s: %s", name, g_strerror(code));
+            close(fd);
+            return NULL;
+        }
+    }
+    else
+    {
+        struct stat st;
+        if (fstat(fd, &st) < 0 || (gsize) st.st_size < sizeof(i3wShmRegion))
+        {
+            g_set_error(err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                    "The workspace helper is not running");
+            close(fd);
+            return NULL;
+        }
+    }
+
+    void *region = mmap(NULL, sizeof(i3wShmRegion),
+            helper ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    if (region == MAP_FAILED)
+    {
+        gint code = errno;
+        g_set_error(err, G_IO_ERROR, g_io_error_from_errno(code),
+                "Failed to map %s: %s", name, g_strerror(code));
+        close(fd);
+        return NULL;
+    }
+
+    i3wShm *shm = g_new0(i3wShm, 1);
+    shm->ref_count = 1;
+    shm->name = g_strdup(name);
+    shm->fd = fd;
+    shm->pidfd = -1;
+    shm->helper = helper;
+    shm->region = region;
+
+    return shm;
+}
+
+/**
+ * shm_unref:
+ * @shm: the region
+ *
+ * Drop a reference, the watch thread and pending notifications hold one.
+ * Closing the descriptor releases the helper lock.
+ */
+static void
+shm_unref(i3wShm *shm)
+{
+    if (!g_atomic_int_dec_and_test(&shm->ref_count))
+        return;
+
+    munmap(shm->region, sizeof(i3wShmRegion));
+    close(shm->fd);
+    g_free(shm->name);
+    g_free(shm);
+}
+
+/**
+ * shm_unref_idle:
+ * @data: the region
+ *
+ * Drop the reference of the watch thread from the main loop.
+ *
+ * Returns: G_SOURCE_REMOVE
+ */
+static gboolean
+shm_unref_idle(gpointer data)
+{
+    shm_unref((i3wShm *) data);
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * helper_alive:
+ * @shm: the region
+ *
+ * Returns: whether the helper publishing into the region is still running
+ */
+static gboolean
+helper_alive(i3wShm *shm)
+{
+    if (!g_atomic_int_get(&shm->region->alive))
+        return FALSE;
+
+    return kill(shm->region->pid, 0) == 0 || errno == EPERM;
+}
+
+/**
+ * open_pidfd:
+ * @pid: the process
+ *
+ * Returns: a descriptor becoming readable when the process exits, or -1
+ * when the kernel does not support pidfds
+ */
+static gint
+open_pidfd(gint pid)
+{
+#if defined(__linux__) && defined(SYS_pidfd_open)
+    return syscall(SYS_pidfd_open, pid, 0);
+#else
+    return -1;
+#endif
+}
+
+/**
+ * on_helper_exited:
+ * @fd: the pidfd of the helper
+ * @condition: the condition
+ * @data: the region
+ *
+ * The helper exited, possibly without clearing the alive flag. Reads fail
+ * from now on and the callback learns about it.
+ *
+ * Returns: G_SOURCE_REMOVE
+ */
+static gboolean
+on_helper_exited(gint fd, GIOCondition condition, gpointer data)
+{
+    i3wShm *shm = (i3wShm *) data;
+
+    shm->pidfd_watch = 0;
+    g_atomic_int_set(&shm->helper_gone, TRUE);
+
+    if (!g_atomic_int_get(&shm->closing))
+        shm->callback(shm->data);
+
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * watch_thread:
+ * @data: the region
+ *
+ * Wait on the generation counter and notify the main loop of changes.
+ *
+ * Returns: NULL
+ */
+static gpointer
+watch_thread(gpointer data)
+{
+    i3wShm *shm = (i3wShm *) data;
+    gint seen = shm->watch_seen;
+    gboolean alive = TRUE;
+
+    // with a pidfd, only the helper and i3w_shm_close wake the thread
+    gint timeout_ms = shm->pidfd >= 0 ? -1 : WATCH_TIMEOUT_MS;
+
+    while (alive && !g_atomic_int_get(&shm->closing))
+    {
+        futex_wait(&shm->region->generation, seen, timeout_ms);
+
+        gint generation = g_atomic_int_get(&shm->region->generation);
+        alive = shm->pidfd >= 0 ? g_atomic_int_get(&shm->region->alive) : helper_alive(shm);
+        if (generation == seen && alive)
+            continue;
+        seen = generation;
+
+        if (g_atomic_int_compare_and_exchange(&shm->wakeup_pending, FALSE, TRUE))
+        {
+            g_atomic_int_inc(&shm->ref_count);
+            g_idle_add_full(G_PRIORITY_DEFAULT, notify_change, shm,
+                    (GDestroyNotify) shm_unref);
+        }
+    }
+
+    g_idle_add(shm_unref_idle, shm);
+    g_atomic_int_set(&shm->watch_done, TRUE);
+
+    return NULL;
+}
+
+/**
+ * notify_change:
+ * @data: the region
+ *
+ * Returns: G_SOURCE_REMOVE
+ */
+static gboolean
+notify_change(gpointer data)
+{
+    i3wShm *shm = (i3wShm *) data;
+
+    // changes from now on need a new wakeup
+    g_atomic_int_set(&shm->wakeup_pending, FALSE);
+
+    if (!g_atomic_int_get(&shm->closing))
+        shm->callback(shm->data);
+
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * futex_wait:
+ * @word: the futex word
+ * @value: the value the word is expected to have
+ * @timeout_ms: the longest time to wait, negative to wait until woken
+ *
+ * Sleep until the word is woken or the timeout passes, unless the word has
+ * already changed. Without futexes this just sleeps.
+ */
+static void
+futex_wait(gint *word, gint value, gint timeout_ms)
+{
+#ifdef __linux__
+    struct timespec timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000 };
+    syscall(SYS_futex, word, FUTEX_WAIT, value, timeout_ms < 0 ? NULL : &timeout, NULL, 0);
+#else
+    if (g_atomic_int_get(word) == value)
+        g_usleep(timeout_ms * 1000);
+#endif
+}
+
+/**
+ * futex_wake:
+ * @word: the futex word
+ *
+ * Wake everyone waiting on the word, in any process.
+ */
+static void
+futex_wake(gint *word)
+{
+#ifdef __linux__
+    syscall(SYS_futex, word, FUTEX_WAKE, G_MAXINT, NULL, NULL, 0);
+#endif
+}
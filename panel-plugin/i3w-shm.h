@@ -0,0 +1,107 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_SHM_H__
+#define __I3W_SHM_H__
+
+#include <glib.h>
+#include <json-glib/json-glib.h>
+
+/*
+ * Workspace model shared between processes. The helper process keeps the
+ * only i3 subscription and publishes the model into a shared memory region,
+ * the plugin instances map it read only. Writes are guarded by a seqlock,
+ * the generation counter doubles as a futex word for change notification.
+ */
+
+#define I3W_SHM_WORKSPACES_MAX 64
+#define I3W_SHM_OUTPUTS_MAX 16
+#define I3W_SHM_NAME_MAX 64
+#define I3W_SHM_OUTPUT_MAX 32
+// the workspace names, unlike the binding mode, are never truncated
+#define I3W_SHM_NAMES_SIZE 16384
+
+#define I3W_SHM_FOCUSED (1 << 0)
+#define I3W_SHM_VISIBLE (1 << 1)
+#define I3W_SHM_URGENT (1 << 2)
+
+typedef struct _i3w_shm_workspace
+{
+    gint32 num;
+    guint32 flags;
+    // offset of the name in i3wShmModel.names
+    guint32 name;
+    gchar output[I3W_SHM_OUTPUT_MAX];
+} i3wShmWorkspace;
+
+typedef struct _i3w_shm_model
+{
+    guint32 n_workspaces;
+    guint32 n_outputs;
+    gchar mode[I3W_SHM_NAME_MAX];
+    i3wShmWorkspace workspaces[I3W_SHM_WORKSPACES_MAX];
+    // the names of the active outputs
+    gchar outputs[I3W_SHM_OUTPUTS_MAX][I3W_SHM_OUTPUT_MAX];
+    // the NUL terminated workspace names, one after the other
+    guint32 names_len;
+    gchar names[I3W_SHM_NAMES_SIZE];
+} i3wShmModel;
+
+typedef struct _i3w_shm i3wShm;
+
+typedef void (*i3wShmCallback) (gpointer data);
+
+gchar *
+i3w_shm_name(const gchar *socket_path);
+
+gboolean
+i3w_shm_model_add_workspace_name(i3wShmModel *model, i3wShmWorkspace *workspace,
+        const gchar *name);
+
+const gchar *
+i3w_shm_model_workspace_name(const i3wShmModel *model, const i3wShmWorkspace *workspace);
+
+void
+i3w_shm_model_load_workspaces(i3wShmModel *model, JsonArray *array);
+
+/* The helper side */
+
+i3wShm *
+i3w_shm_create(const gchar *name, GError **err);
+
+void
+i3w_shm_publish(i3wShm *shm, const i3wShmModel *model);
+
+void
+i3w_shm_destroy(i3wShm *shm);
+
+/* The plugin side */
+
+i3wShm *
+i3w_shm_open(const gchar *name, GError **err);
+
+gboolean
+i3w_shm_read(i3wShm *shm, i3wShmModel *model, gint *generation);
+
+void
+i3w_shm_watch(i3wShm *shm, gint generation, i3wShmCallback callback, gpointer data);
+
+void
+i3w_shm_close(i3wShm *shm);
+
+#endif /* !__I3W_SHM_H__ */
@@ -0,0 +1,215 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include "i3w-snapshot.h"
+
+#define SNAPSHOT_FOCUSED 1
+#define SNAPSHOT_VISIBLE 2
+
+/*
+ * Prototypes
+ */
+
+static i3workspace *
+snapshot_workspace_new(const gchar *name, gint num, gint state,
+        const gchar *output);
+
+static void
+snapshot_workspace_free(i3workspace *workspace);
+
+/*
+ * Implementations of public functions
+ */
+
+/**
+ * i3w_snapshot_parse:
+ * @data: the contents of the snapshot file
+ *
+ * Parse a snapshot written by i3w_snapshot_serialize. Malformed groups are
+ * skipped.
+ *
+ * Returns: the list of i3workspace, free it with i3w_snapshot_free.
+ */
+GSList *
+i3w_snapshot_parse(const gchar *data)
+{
+    GKeyFile *key_file = g_key_file_new();
+    GSList *wlist = NULL;
+
+    if (g_key_file_load_from_data(key_file, data, -1, G_KEY_FILE_NONE, NULL))
+    {
+        gchar **outputs = g_key_file_get_groups(key_file, NULL);
+        gchar **output;
+
+        for (output = outputs; *output; output++)
+        {
+            gsize n_names = 0, n_nums = 0, n_states = 0;
+            gchar **names = g_key_file_get_string_list(key_file, *output, "names", &n_names, NULL);
+            gint *nums = g_key_file_get_integer_list(key_file, *output, "nums", &n_nums, NULL);
+            gint *states = g_key_file_get_integer_list(key_file, *output, "states", &n_states, NULL);
+            gsize i;
+
+            if (names && n_names == n_nums && n_names == n_states)
+            {
+                for (i = 0; i < n_names; i++)
+                {
+                    wlist = g_slist_prepend(wlist,
+                            snapshot_workspace_new(names[i], nums[i], states[i], *output));
+                }
+            }
+
+            g_strfreev(names);
+            g_free(nums);
+            g_free(states);
+        }
+
+        g_strfreev(outputs);
+    }
+
+    g_key_file_free(key_file);
+
+    return g_slist_reverse(wlist);
+}
+
+/**
+ * i3w_snapshot_serialize:
+ * @wlist: the list of i3workspace
+ *
+ * The workspaces of each output are stored in one group, in their order in
+ * the list.
+ *
+ * Returns: the newly allocated contents of the snapshot file
+ */
+gchar *
+i3w_snapshot_serialize(GSList *wlist)
+{
+    GKeyFile *key_file = g_key_file_new();
+    // output => GPtrArray of i3workspace *, in the order of the list
+    GHashTable *outputs = g_hash_table_new_full(g_str_hash, g_str_equal,
+            NULL, (GDestroyNotify) g_ptr_array_unref);
+    GList *order = NULL, *oitem;
+    GSList *witem;
+
+    for (witem = wlist; witem != NULL; witem = witem->next)
+    {
+        i3workspace *workspace = (i3workspace *) witem->data;
+        if (!workspace->output || !workspace->output[0])
+            continue;
+
+        GPtrArray *workspaces = g_hash_table_lookup(outputs, workspace->output);
+        if (!workspaces)
+        {
+            workspaces = g_ptr_array_new();
+            g_hash_table_insert(outputs, workspace->output, workspaces);
+            order = g_list_prepend(order, workspace->output);
+        }
+        g_ptr_array_add(workspaces, workspace);
+    }
+
+    order = g_list_reverse(order);
+    for (oitem = order; oitem != NULL; oitem = oitem->next)
+    {
+        const gchar *output = (const gchar *) oitem->data;
+        GPtrArray *workspaces = g_hash_table_lookup(outputs, output);
+        const gchar **names = g_new0(const gchar *, workspaces->len + 1);
+        gint *nums = g_new(gint, workspaces->len);
+        gint *states = g_new(gint, workspaces->len);
+        guint i;
+
+        for (i = 0; i < workspaces->len; i++)
+        {
+            i3workspace *workspace = g_ptr_array_index(workspaces, i);
+            names[i] = workspace->name;
+            nums[i] = workspace->num;
+            states[i] = (workspace->focused ? SNAPSHOT_FOCUSED : 0) |
+                (workspace->visible ? SNAPSHOT_VISIBLE : 0);
+        }
+
+        g_key_file_set_string_list(key_file, output, "names", names, workspaces->len);
+        g_key_file_set_integer_list(key_file, output, "nums", nums, workspaces->len);
+        g_key_file_set_integer_list(key_file, output, "states", states, workspaces->len);
+
+        g_free(names);
+        g_free(nums);
+        g_free(states);
+    }
+
+    gchar *data = g_key_file_to_data(key_file, NULL, NULL);
+
+    g_list_free(order);
+    g_hash_table_destroy(outputs);
+    g_key_file_free(key_file);
+
+    return data;
+}
+
+/**
+ * i3w_snapshot_free:
+ * @wlist: a list returned by i3w_snapshot_parse
+ *
+ * Free the workspaces and the list.
+ */
+void
+i3w_snapshot_free(GSList *wlist)
+{
+    g_slist_free_full(wlist, (GDestroyNotify) snapshot_workspace_free);
+}
+
+/*
+ * Implementations of private functions
+ */
+
+/**
+ * snapshot_workspace_new:
+ * @name: the name of the workspace
+ * @num: the number of the workspace
+ * @state: the SNAPSHOT_* flags
+ * @output: the output of the workspace
+ *
+ * Returns: the new workspace
+ */
+static i3workspace *
+snapshot_workspace_new(const gchar *name, gint num, gint state,
+        const gchar *output)
+{
+    i3workspace *workspace = g_new0(i3workspace, 1);
+
+    workspace->num = num;
+    workspace->name = g_strdup(name);
+    workspace->focused = (state & SNAPSHOT_FOCUSED) != 0;
+    workspace->visible = (state & SNAPSHOT_VISIBLE) != 0;
+    workspace->output = g_strdup(output);
+
+    return workspace;
+}
+
+/**
+ * snapshot_workspace_free:
+ * @workspace: the workspace
+ *
+ * Free a workspace created by snapshot_workspace_new.
+ */
+static void
+snapshot_workspace_free(i3workspace *workspace)
+{
+    g_free(workspace->name);
+    g_free(workspace->output);
+    g_free(workspace);
+}
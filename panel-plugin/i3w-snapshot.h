@@ -0,0 +1,41 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_SNAPSHOT_H__
+#define __I3W_SNAPSHOT_H__
+
+#include <glib.h>
+
+#include "i3wm-delegate.h"
+
+/*
+ * The last known workspace list, grouped by output, so the buttons can be
+ * shown before the window manager answers. Stored as a key file; the urgent
+ * flags are not kept, they would be stale by the next session anyway.
+ */
+
+GSList *
+i3w_snapshot_parse(const gchar *data);
+
+gchar *
+i3w_snapshot_serialize(GSList *wlist);
+
+void
+i3w_snapshot_free(GSList *wlist);
+
+#endif /* !__I3W_SNAPSHOT_H__ */
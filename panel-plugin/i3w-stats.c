@@ -0,0 +1,263 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <glib-unix.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "i3w-stats.h"
+
+static gint stats[I3W_STAT_COUNT];
+static gint timings[I3W_TIMING_COUNT][I3W_TIMING_BUCKETS];
+
+static const gchar *stat_names[I3W_STAT_COUNT] = {
+    "workspace events",
+    "output events",
+    "mode events",
+    "window events",
+    "full resyncs",
+    "skipped refreshes",
+    "failed refreshes",
+    "buttons created",
+    "buttons destroyed",
+    "timer wakeups",
+    "reconnect attempts",
+    "live workspaces",
+    "live buttons",
+};
+
+typedef struct
+{
+    i3wStatsSource source;
+    gpointer data;
+} i3wStatsSourceEntry;
+
+// i3wStatsSourceEntry *, only touched by the main loop
+static GSList *sources = NULL;
+
+static const gchar *timing_names[I3W_TIMING_COUNT] = {
+    "ipc round trip",
+    "model update",
+    "ui update",
+    "tick round trip",
+    "click to focus",
+};
+
+/*
+ * Prototypes
+ */
+
+static gint
+timing_percentile(const gint *buckets, gint total, gint percent);
+
+static gboolean
+on_dump_signal(gpointer data);
+
+/*
+ * Implementations of public functions
+ */
+
+/**
+ * i3w_stats_add:
+ * @stat: the counter
+ * @delta: the value to add, negative for gauges going down
+ *
+ * Safe to call from any thread.
+ */
+void
+i3w_stats_add(i3wStat stat, gint delta)
+{
+    g_atomic_int_add(&stats[stat], delta);
+}
+
+/**
+ * i3w_stats_record:
+ * @timing: the histogram
+ * @start: the g_get_monotonic_time() the measured operation started at
+ *
+ * Records the time passed since @start. Safe to call from any thread.
+ */
+void
+i3w_stats_record(i3wTiming timing, gint64 start)
+{
+    gint64 usec = g_get_monotonic_time() - start;
+    guint bucket = usec > 0 ? g_bit_storage((gulong) usec) : 0;
+
+    g_atomic_int_inc(&timings[timing][MIN(bucket, I3W_TIMING_BUCKETS - 1)]);
+}
+
+/**
+ * i3w_stats_add_source:
+ * @source: appends its counters to the text
+ * @data: the data to be passed to @source
+ *
+ * Adds counters to the diagnostics until i3w_stats_remove_source.
+ */
+void
+i3w_stats_add_source(i3wStatsSource source, gpointer data)
+{
+    i3wStatsSourceEntry *entry = g_new(i3wStatsSourceEntry, 1);
+
+    entry->source = source;
+    entry->data = data;
+    sources = g_slist_append(sources, entry);
+}
+
+/**
+ * i3w_stats_remove_source:
+ * @source: the source given to i3w_stats_add_source
+ * @data: the data given to i3w_stats_add_source
+ *
+ * Removes counters from the diagnostics.
+ */
+void
+i3w_stats_remove_source(i3wStatsSource source, gpointer data)
+{
+    GSList *item;
+
+    for (item = sources; item != NULL; item = item->next)
+    {
+        i3wStatsSourceEntry *entry = (i3wStatsSourceEntry *) item->data;
+        if (entry->source == source && entry->data == data)
+        {
+            sources = g_slist_delete_link(sources, item);
+            g_free(entry);
+            return;
+        }
+    }
+}
+
+/**
+ * i3w_stats_format:
+ *
+ * Formats the current counters and timing histograms as a fixed width
+ * table, followed by the counters of the sources. The percentiles are the
+ * upper bounds of their buckets.
+ *
+ * Returns: the newly allocated text.
+ */
+gchar *
+i3w_stats_format(void)
+{
+    GString *text = g_string_new(NULL);
+
+    for (gint i = 0; i < I3W_STAT_COUNT; i++)
+    {
+        g_string_append_printf(text, "%-18s %10d\n",
+                stat_names[i], g_atomic_int_get(&stats[i]));
+    }
+
+    g_string_append_printf(text, "\n%-18s %10s %8s %8s %8s\n",
+            "timings (us)", "count", "p50", "p99", "max");
+
+    for (gint i = 0; i < I3W_TIMING_COUNT; i++)
+    {
+        gint buckets[I3W_TIMING_BUCKETS];
+        gint total = 0;
+
+        for (gint b = 0; b < I3W_TIMING_BUCKETS; b++)
+        {
+            buckets[b] = g_atomic_int_get(&timings[i][b]);
+            total += buckets[b];
+        }
+
+        g_string_append_printf(text, "%-18s %10d %8d %8d %8d\n",
+                timing_names[i], total,
+                timing_percentile(buckets, total, 50),
+                timing_percentile(buckets, total, 99),
+                timing_percentile(buckets, total, 100));
+    }
+
+    GSList *item;
+    for (item = sources; item != NULL; item = item->next)
+    {
+        i3wStatsSourceEntry *entry = (i3wStatsSourceEntry *) item->data;
+        entry->source(text, entry->data);
+    }
+
+    return g_string_free(text, FALSE);
+}
+
+/**
+ * i3w_stats_dump_on_signal:
+ *
+ * Makes SIGUSR1 print the statistics to stderr. Only the first call has
+ * any effect.
+ */
+void
+i3w_stats_dump_on_signal(void)
+{
+    static gsize installed = 0;
+
+    if (g_once_init_enter(&installed))
+    {
+        g_unix_signal_add(SIGUSR1, on_dump_signal, NULL);
+        g_once_init_leave(&installed, 1);
+    }
+}
+
+/*
+ * Implementations of private functions
+ */
+
+/**
+ * timing_percentile:
+ * @buckets: the histogram
+ * @total: the sum of the buckets
+ * @percent: the percentile
+ *
+ * Returns: the upper bound of the bucket the percentile falls into, 0 for an
+ * empty histogram.
+ */
+static gint
+timing_percentile(const gint *buckets, gint total, gint percent)
+{
+    gint64 rank = ((gint64) total * percent + 99) / 100;
+    gint64 seen = 0;
+
+    if (total == 0) return 0;
+
+    for (gint b = 0; b < I3W_TIMING_BUCKETS; b++)
+    {
+        seen += buckets[b];
+        if (seen >= rank) return 1 << b;
+    }
+
+    return 1 << (I3W_TIMING_BUCKETS - 1);
+}
+
+/**
+ * on_dump_signal:
+ * @data: unused
+ *
+ * SIGUSR1 handler, runs on the main loop.
+ *
+ * Returns: G_SOURCE_CONTINUE
+ */
+static gboolean
+on_dump_signal(gpointer data)
+{
+    gchar *text = i3w_stats_format();
+
+    g_printerr("xfce4-i3-workspaces-plugin statistics (pid %d)\n%s",
+            (gint) getpid(), text);
+    g_free(text);
+
+    return G_SOURCE_CONTINUE;
+}
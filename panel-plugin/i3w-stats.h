@@ -0,0 +1,87 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_STATS_H__
+#define __I3W_STATS_H__
+
+#include <glib.h>
+
+/*
+ * Process wide performance counters. Updating them is a single atomic
+ * operation, reading them is only meant for the diagnostics.
+ */
+
+typedef enum
+{
+    I3W_STAT_WORKSPACE_EVENTS,
+    I3W_STAT_OUTPUT_EVENTS,
+    I3W_STAT_MODE_EVENTS,
+    I3W_STAT_WINDOW_EVENTS,
+    I3W_STAT_RESYNCS,
+    // batches of events leaving the workspaces as they were
+    I3W_STAT_SUPPRESSED_REFRESHES,
+    I3W_STAT_REFRESH_FAILURES,
+    I3W_STAT_BUTTONS_CREATED,
+    I3W_STAT_BUTTONS_DESTROYED,
+    // timeouts dispatched, the only wakeups while nothing happens
+    I3W_STAT_TIMER_WAKEUPS,
+    I3W_STAT_RECONNECT_ATTEMPTS,
+    // gauges, going up and down
+    I3W_STAT_LIVE_WORKSPACES,
+    I3W_STAT_LIVE_BUTTONS,
+    I3W_STAT_COUNT
+} i3wStat;
+
+typedef enum
+{
+    I3W_TIMING_IPC_ROUND_TRIP,
+    I3W_TIMING_MODEL_UPDATE,
+    I3W_TIMING_UI_UPDATE,
+    I3W_TIMING_TICK_ROUND_TRIP,
+    I3W_TIMING_CLICK_TO_FOCUS,
+    I3W_TIMING_COUNT
+} i3wTiming;
+
+// bucket b counts the durations below 2^b microseconds not in bucket b - 1
+#define I3W_TIMING_BUCKETS 24
+
+/*
+ * Appends the counters kept elsewhere, by one of the plugin instances, to
+ * the diagnostics. Sources are only added, removed and run on the main loop.
+ */
+typedef void (*i3wStatsSource) (GString *text, gpointer data);
+
+void
+i3w_stats_add(i3wStat stat, gint delta);
+
+void
+i3w_stats_record(i3wTiming timing, gint64 start);
+
+void
+i3w_stats_add_source(i3wStatsSource source, gpointer data);
+
+void
+i3w_stats_remove_source(i3wStatsSource source, gpointer data);
+
+gchar *
+i3w_stats_format(void);
+
+void
+i3w_stats_dump_on_signal(void);
+
+#endif /* !__I3W_STATS_H__ */
@@ -0,0 +1,637 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtk/gtk.h>
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#ifdef HAVE_LIBXDAMAGE
+#include <X11/extensions/Xdamage.h>
+#endif
+
+#include "i3w-thumbnails.h"
+#include "i3w-trace.h"
+
+#define THUMBNAIL_WIDTH 240
+#define THUMBNAIL_CACHE_SIZE 16
+#define REFRESH_DELAY_MS 1000
+
+typedef struct
+{
+    gchar *workspace;
+    GdkPixbuf *pixbuf;
+} i3wThumbnail;
+
+typedef struct
+{
+    i3wThumbnails *thumbnails;
+    gchar *workspace;
+    GdkRectangle area;
+    GdkPixbuf *pixbuf;
+    // set once the workspace is no longer visible
+    gint cancelled;
+    gint64 trace;
+} i3wCaptureJob;
+
+struct _i3w_thumbnails
+{
+    gint ref_count;
+    gboolean destroyed;
+
+    i3wThumbnailsRefreshCallback refresh;
+    gpointer refresh_data;
+    guint refresh_timeout;
+
+    // i3wThumbnail *, most recently used first, and workspace name => GList *
+    GQueue *lru;
+    GHashTable *index;
+    // workspace name => i3wCaptureJob * of the captures in flight
+    GHashTable *pending;
+
+    GThreadPool *pool;
+    // the worker's own X connection, only used from the worker thread
+    Display *xdisplay;
+
+#ifdef HAVE_LIBXDAMAGE
+    Display *damage_display;
+    Damage damage;
+    int damage_event_base;
+    XserverRegion damage_region;
+    // the areas drawn to since the previous refresh, only set during one
+    gboolean damage_known;
+    GArray *damaged;
+#endif
+};
+
+/*
+ * Prototypes
+ */
+static void
+thumbnails_unref(i3wThumbnails *thumbnails);
+static void
+destroy_thumbnail(i3wThumbnail *thumbnail);
+static void
+store_thumbnail(i3wThumbnails *thumbnails, const gchar *workspace, GdkPixbuf *pixbuf);
+static gboolean
+on_refresh_timeout(gpointer data);
+static void
+capture_worker(gpointer data, gpointer user_data);
+static gboolean
+on_capture_done(gpointer data);
+static gboolean
+area_damaged(i3wThumbnails *thumbnails, const GdkRectangle *area);
+static GdkPixbuf *
+grab_scaled(Display *dpy, const GdkRectangle *area);
+static guint
+mask_shift(gulong mask);
+
+#ifdef HAVE_LIBXDAMAGE
+static void
+setup_damage(i3wThumbnails *thumbnails);
+static void
+teardown_damage(i3wThumbnails *thumbnails);
+static GdkFilterReturn
+damage_filter(GdkXEvent *xevent, GdkEvent *event, gpointer data);
+#endif
+
+/*
+ * Implementations of public functions
+ */
+
+/**
+ * i3w_thumbnails_new:
+ * @refresh: called when the thumbnails of the visible workspaces should be
+ * captured again
+ * @data: the data to be passed to the callback function
+ *
+ * Create the thumbnail cache. With XDamage available the refresh callback
+ * only runs after something was drawn on the screen, and only the
+ * workspaces whose area was drawn to are captured again.
+ *
+ * Returns: the thumbnail cache
+ */
+i3wThumbnails *
+i3w_thumbnails_new(i3wThumbnailsRefreshCallback refresh, gpointer data)
+{
+    i3wThumbnails *thumbnails = g_new0(i3wThumbnails, 1);
+
+    thumbnails->ref_count = 1;
+    thumbnails->refresh = refresh;
+    thumbnails->refresh_data = data;
+    thumbnails->lru = g_queue_new();
+    thumbnails->index = g_hash_table_new(g_str_hash, g_str_equal);
+    thumbnails->pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    thumbnails->pool = g_thread_pool_new(capture_worker, thumbnails, 1, FALSE, NULL);
+
+#ifdef HAVE_LIBXDAMAGE
+    setup_damage(thumbnails);
+#endif
+
+    return thumbnails;
+}
+
+/**
+ * i3w_thumbnails_free:
+ * @thumbnails: the thumbnail cache
+ *
+ * Free the thumbnail cache. Queued captures are skipped by the worker and
+ * the results of a capture already running are discarded.
+ */
+void
+i3w_thumbnails_free(i3wThumbnails *thumbnails)
+{
+#ifdef HAVE_LIBXDAMAGE
+    teardown_damage(thumbnails);
+#endif
+
+    if (thumbnails->refresh_timeout)
+    {
+        g_source_remove(thumbnails->refresh_timeout);
+        thumbnails->refresh_timeout = 0;
+    }
+
+    g_atomic_int_set(&thumbnails->destroyed, TRUE);
+    g_thread_pool_free(thumbnails->pool, FALSE, FALSE);
+    thumbnails->pool = NULL;
+
+    thumbnails_unref(thumbnails);
+}
+
+/**
+ * i3w_thumbnails_invalidate:
+ * @thumbnails: the thumbnail cache
+ *
+ * Schedule a refresh of the visible workspaces. Refreshes are rate limited,
+ * any number of invalidations within the delay result in one refresh.
+ */
+void
+i3w_thumbnails_invalidate(i3wThumbnails *thumbnails)
+{
+    if (thumbnails->destroyed || thumbnails->refresh_timeout)
+        return;
+
+    thumbnails->refresh_timeout = g_timeout_add(REFRESH_DELAY_MS,
+            on_refresh_timeout, thumbnails);
+}
+
+/**
+ * i3w_thumbnails_capture:
+ * @thumbnails: the thumbnail cache
+ * @workspace: the name of the workspace
+ * @area: the area of the screen showing the workspace
+ *
+ * Queue a capture of the workspace, unless one is already in flight or,
+ * during a refresh, nothing was drawn to the area since the last one.
+ */
+void
+i3w_thumbnails_capture(i3wThumbnails *thumbnails, const gchar *workspace,
+        const GdkRectangle *area)
+{
+    if (thumbnails->destroyed || g_hash_table_contains(thumbnails->pending, workspace))
+        return;
+
+    if (g_hash_table_contains(thumbnails->index, workspace) &&
+        !area_damaged(thumbnails, area))
+        return;
+
+    i3wCaptureJob *job = g_new0(i3wCaptureJob, 1);
+    job->thumbnails = thumbnails;
+    job->workspace = g_strdup(workspace);
+    job->area = *area;
+
+    g_atomic_int_inc(&thumbnails->ref_count);
+    g_hash_table_insert(thumbnails->pending, g_strdup(workspace), job);
+    g_thread_pool_push(thumbnails->pool, job, NULL);
+}
+
+/**
+ * i3w_thumbnails_cancel:
+ * @thumbnails: the thumbnail cache
+ * @workspace: the name of the workspace
+ *
+ * The workspace is no longer visible, drop its capture in flight so the
+ * screen showing another workspace is not stored under its name.
+ */
+void
+i3w_thumbnails_cancel(i3wThumbnails *thumbnails, const gchar *workspace)
+{
+    i3wCaptureJob *job = g_hash_table_lookup(thumbnails->pending, workspace);
+
+    if (job)
+        g_atomic_int_set(&job->cancelled, TRUE);
+}
+
+/**
+ * i3w_thumbnails_lookup:
+ * @thumbnails: the thumbnail cache
+ * @workspace: the name of the workspace
+ *
+ * Returns: (transfer none): the last thumbnail of the workspace or NULL
+ */
+GdkPixbuf *
+i3w_thumbnails_lookup(i3wThumbnails *thumbnails, const gchar *workspace)
+{
+    GList *link = g_hash_table_lookup(thumbnails->index, workspace);
+    if (!link)
+        return NULL;
+
+    g_queue_unlink(thumbnails->lru, link);
+    g_queue_push_head_link(thumbnails->lru, link);
+
+    return ((i3wThumbnail *) link->data)->pixbuf;
+}
+
+/*
+ * Implementations of private functions
+ */
+
+/**
+ * thumbnails_unref:
+ * @thumbnails: the thumbnail cache
+ *
+ * Drop a reference, the capture jobs hold one each. Always called from the
+ * main thread, after the worker is done with the X connection.
+ */
+static void
+thumbnails_unref(i3wThumbnails *thumbnails)
+{
+    if (!g_atomic_int_dec_and_test(&thumbnails->ref_count))
+        return;
+
+    if (thumbnails->xdisplay)
+        XCloseDisplay(thumbnails->xdisplay);
+
+    g_queue_free_full(thumbnails->lru, (GDestroyNotify) destroy_thumbnail);
+    g_hash_table_destroy(thumbnails->index);
+    g_hash_table_destroy(thumbnails->pending);
+    g_free(thumbnails);
+}
+
+/**
+ * destroy_thumbnail:
+ * @thumbnail: the thumbnail
+ *
+ * Free the thumbnail.
+ */
+static void
+destroy_thumbnail(i3wThumbnail *thumbnail)
+{
+    g_object_unref(thumbnail->pixbuf);
+    g_free(thumbnail->workspace);
+    g_free(thumbnail);
+}
+
+/**
+ * store_thumbnail:
+ * @thumbnails: the thumbnail cache
+ * @workspace: the name of the workspace
+ * @pixbuf: the thumbnail, the cache takes a reference
+ *
+ * Store the thumbnail as the most recently used one, evicting the least
+ * recently used ones above the cache size.
+ */
+static void
+store_thumbnail(i3wThumbnails *thumbnails, const gchar *workspace, GdkPixbuf *pixbuf)
+{
+    GList *link = g_hash_table_lookup(thumbnails->index, workspace);
+    if (link)
+    {
+        g_hash_table_remove(thumbnails->index, workspace);
+        destroy_thumbnail((i3wThumbnail *) link->data);
+        g_queue_delete_link(thumbnails->lru, link);
+    }
+
+    i3wThumbnail *thumbnail = g_new0(i3wThumbnail, 1);
+    thumbnail->workspace = g_strdup(workspace);
+    thumbnail->pixbuf = g_object_ref(pixbuf);
+    g_queue_push_head(thumbnails->lru, thumbnail);
+    g_hash_table_insert(thumbnails->index, thumbnail->workspace,
+            g_queue_peek_head_link(thumbnails->lru));
+
+    while (g_queue_get_length(thumbnails->lru) > THUMBNAIL_CACHE_SIZE)
+    {
+        i3wThumbnail *oldest = (i3wThumbnail *) g_queue_pop_tail(thumbnails->lru);
+        g_hash_table_remove(thumbnails->index, oldest->workspace);
+        destroy_thumbnail(oldest);
+    }
+}
+
+/**
+ * on_refresh_timeout:
+ * @data: the thumbnail cache
+ *
+ * Re-arm the damage tracking and ask for the visible workspaces.
+ *
+ * Returns: G_SOURCE_REMOVE
+ */
+static gboolean
+on_refresh_timeout(gpointer data)
+{
+    i3wThumbnails *thumbnails = (i3wThumbnails *) data;
+
+    thumbnails->refresh_timeout = 0;
+
+#ifdef HAVE_LIBXDAMAGE
+    if (thumbnails->damage)
+    {
+        XRectangle *rects;
+        int n, i;
+
+        XDamageSubtract(thumbnails->damage_display, thumbnails->damage, None,
+                thumbnails->damage_region);
+        rects = XFixesFetchRegion(thumbnails->damage_display, thumbnails->damage_region, &n);
+        for (i = 0; rects && i < n; i++)
+        {
+            GdkRectangle rect = { rects[i].x, rects[i].y, rects[i].width, rects[i].height };
+            g_array_append_val(thumbnails->damaged, rect);
+        }
+        if (rects)
+            XFree(rects);
+        thumbnails->damage_known = TRUE;
+    }
+#endif
+
+    thumbnails->refresh(thumbnails, thumbnails->refresh_data);
+
+#ifdef HAVE_LIBXDAMAGE
+    thumbnails->damage_known = FALSE;
+    if (thumbnails->damaged)
+        g_array_set_size(thumbnails->damaged, 0);
+#endif
+
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * capture_worker:
+ * @data: the capture job
+ * @user_data: the thumbnail cache
+ *
+ * Grab and downscale the workspace on the worker thread, then hand the
+ * result to the main loop.
+ */
+static void
+capture_worker(gpointer data, gpointer user_data)
+{
+    i3wCaptureJob *job = (i3wCaptureJob *) data;
+    i3wThumbnails *thumbnails = job->thumbnails;
+
+    job->trace = i3w_trace_begin();
+
+    if (g_atomic_int_get(&job->cancelled) || g_atomic_int_get(&thumbnails->destroyed))
+    {
+        g_idle_add(on_capture_done, job);
+        return;
+    }
+
+    if (!thumbnails->xdisplay)
+        thumbnails->xdisplay = XOpenDisplay(NULL);
+
+    if (thumbnails->xdisplay && !g_atomic_int_get(&job->cancelled))
+        job->pixbuf = grab_scaled(thumbnails->xdisplay, &job->area);
+
+    g_idle_add(on_capture_done, job);
+}
+
+/**
+ * on_capture_done:
+ * @data: the capture job
+ *
+ * Store the result of the capture, unless the workspace was hidden
+ * meanwhile.
+ *
+ * Returns: G_SOURCE_REMOVE
+ */
+static gboolean
+on_capture_done(gpointer data)
+{
+    i3wCaptureJob *job = (i3wCaptureJob *) data;
+    i3wThumbnails *thumbnails = job->thumbnails;
+
+    g_hash_table_remove(thumbnails->pending, job->workspace);
+    if (job->pixbuf)
+    {
+        if (!thumbnails->destroyed && !job->cancelled)
+        {
+            store_thumbnail(thumbnails, job->workspace, job->pixbuf);
+            i3w_trace_end("thumbnail_capture", job->trace, job->workspace,
+                    g_queue_get_length(thumbnails->lru));
+        }
+        g_object_unref(job->pixbuf);
+    }
+
+    g_free(job->workspace);
+    g_free(job);
+    thumbnails_unref(thumbnails);
+
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * area_damaged:
+ * @thumbnails: the thumbnail cache
+ * @area: an area of the screen
+ *
+ * Returns: whether the area was drawn to since the previous refresh, TRUE
+ * when that is not known
+ */
+static gboolean
+area_damaged(i3wThumbnails *thumbnails, const GdkRectangle *area)
+{
+#ifdef HAVE_LIBXDAMAGE
+    guint i;
+
+    if (!thumbnails->damage_known)
+        return TRUE;
+
+    for (i = 0; i < thumbnails->damaged->len; i++)
+    {
+        if (gdk_rectangle_intersect(&g_array_index(thumbnails->damaged, GdkRectangle, i),
+                    area, NULL))
+            return TRUE;
+    }
+
+    return FALSE;
+#else
+    return TRUE;
+#endif
+}
+
+/**
+ * grab_scaled:
+ * @dpy: the X connection
+ * @area: the area of the screen to grab
+ *
+ * Grab the area of the root window and sample it down to the thumbnail
+ * size, without building a full size pixbuf first.
+ *
+ * Returns: the thumbnail or NULL
+ */
+static GdkPixbuf *
+grab_scaled(Display *dpy, const GdkRectangle *area)
+{
+    XWindowAttributes attrs;
+    Window root = DefaultRootWindow(dpy);
+    GdkRectangle clip;
+
+    // a request outside of the root window would be a fatal X error
+    if (!XGetWindowAttributes(dpy, root, &attrs))
+        return NULL;
+    clip.x = MAX(area->x, 0);
+    clip.y = MAX(area->y, 0);
+    clip.width = MIN(area->x + area->width, attrs.width) - clip.x;
+    clip.height = MIN(area->y + area->height, attrs.height) - clip.y;
+    if (clip.width <= 0 || clip.height <= 0)
+        return NULL;
+
+    XImage *image = XGetImage(dpy, root, clip.x, clip.y, clip.width, clip.height,
+            AllPlanes, ZPixmap);
+    if (!image)
+        return NULL;
+
+    gint width = MIN(THUMBNAIL_WIDTH, clip.width);
+    gint height = MAX(1, clip.height * width / clip.width);
+    GdkPixbuf *pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, width, height);
+    guchar *pixels = gdk_pixbuf_get_pixels(pixbuf);
+    gint rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+
+    guint rshift = mask_shift(image->red_mask);
+    guint gshift = mask_shift(image->green_mask);
+    guint bshift = mask_shift(image->blue_mask);
+    gulong rmax = MAX(image->red_mask >> rshift, 1);
+    gulong gmax = MAX(image->green_mask >> gshift, 1);
+    gulong bmax = MAX(image->blue_mask >> bshift, 1);
+
+    gint x, y;
+    for (y = 0; y < height; y++)
+    {
+        guchar *row = pixels + y * rowstride;
+        gint sy = y * clip.height / height;
+
+        for (x = 0; x < width; x++)
+        {
+            gulong pixel = XGetPixel(image, x * clip.width / width, sy);
+
+            row[3 * x] = ((pixel & image->red_mask) >> rshift) * 255 / rmax;
+            row[3 * x + 1] = ((pixel & image->green_mask) >> gshift) * 255 / gmax;
+            row[3 * x + 2] = ((pixel & image->blue_mask) >> bshift) * 255 / bmax;
+        }
+    }
+
+    XDestroyImage(image);
+
+    return pixbuf;
+}
+
+/**
+ * mask_shift:
+ * @mask: a colour channel mask
+ *
+ * Returns: the position of the lowest bit set in the mask
+ */
+static guint
+mask_shift(gulong mask)
+{
+    guint shift = 0;
+
+    while (mask && !(mask & 1))
+    {
+        mask >>= 1;
+        shift++;
+    }
+
+    return shift;
+}
+
+#ifdef HAVE_LIBXDAMAGE
+/**
+ * setup_damage:
+ * @thumbnails: the thumbnail cache
+ *
+ * Watch the root window for damage. Only one notification arrives until the
+ * damage is subtracted in the next refresh, which tells the areas drawn to
+ * apart so the outputs left alone are not grabbed again.
+ */
+static void
+setup_damage(i3wThumbnails *thumbnails)
+{
+    GdkDisplay *display = gdk_display_get_default();
+    int error_base;
+
+    if (!GDK_IS_X11_DISPLAY(display))
+        return;
+
+    Display *dpy = GDK_DISPLAY_XDISPLAY(display);
+    if (!XDamageQueryExtension(dpy, &thumbnails->damage_event_base, &error_base))
+        return;
+
+    thumbnails->damage_display = dpy;
+    thumbnails->damage = XDamageCreate(dpy, DefaultRootWindow(dpy),
+            XDamageReportNonEmpty);
+    thumbnails->damage_region = XFixesCreateRegion(dpy, NULL, 0);
+    thumbnails->damaged = g_array_new(FALSE, FALSE, sizeof(GdkRectangle));
+    gdk_window_add_filter(NULL, damage_filter, thumbnails);
+}
+
+/**
+ * teardown_damage:
+ * @thumbnails: the thumbnail cache
+ *
+ * Stop watching the root window.
+ */
+static void
+teardown_damage(i3wThumbnails *thumbnails)
+{
+    if (!thumbnails->damage)
+        return;
+
+    gdk_window_remove_filter(NULL, damage_filter, thumbnails);
+    XDamageDestroy(thumbnails->damage_display, thumbnails->damage);
+    XFixesDestroyRegion(thumbnails->damage_display, thumbnails->damage_region);
+    g_array_free(thumbnails->damaged, TRUE);
+    thumbnails->damage = None;
+    thumbnails->damaged = NULL;
+}
+
+/**
+ * damage_filter:
+ * @xevent: the X event
+ * @event: the GDK event
+ * @data: the thumbnail cache
+ *
+ * Schedule a refresh when the screen was drawn to.
+ *
+ * Returns: GDK_FILTER_CONTINUE
+ */
+static GdkFilterReturn
+damage_filter(GdkXEvent *xevent, GdkEvent *event, gpointer data)
+{
+    i3wThumbnails *thumbnails = (i3wThumbnails *) data;
+    XEvent *xev = (XEvent *) xevent;
+
+    if (xev->type == thumbnails->damage_event_base + XDamageNotify &&
+        ((XDamageNotifyEvent *) xev)->damage == thumbnails->damage)
+        i3w_thumbnails_invalidate(thumbnails);
+
+    return GDK_FILTER_CONTINUE;
+}
+#endif
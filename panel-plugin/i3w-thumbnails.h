@@ -0,0 +1,54 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_THUMBNAILS_H__
+#define __I3W_THUMBNAILS_H__
+
+#include <gtk/gtk.h>
+
+/*
+ * Small pictures of the workspaces, taken from the screen while a workspace
+ * is visible. Screen grabs and downscaling run on a worker thread with its
+ * own X connection, the results are kept in a bounded LRU cache. An output
+ * is only grabbed again after something was drawn on it.
+ */
+
+typedef struct _i3w_thumbnails i3wThumbnails;
+
+typedef void (*i3wThumbnailsRefreshCallback) (i3wThumbnails *thumbnails, gpointer data);
+
+i3wThumbnails *
+i3w_thumbnails_new(i3wThumbnailsRefreshCallback refresh, gpointer data);
+
+void
+i3w_thumbnails_free(i3wThumbnails *thumbnails);
+
+void
+i3w_thumbnails_invalidate(i3wThumbnails *thumbnails);
+
+void
+i3w_thumbnails_capture(i3wThumbnails *thumbnails, const gchar *workspace,
+        const GdkRectangle *area);
+
+void
+i3w_thumbnails_cancel(i3wThumbnails *thumbnails, const gchar *workspace);
+
+GdkPixbuf *
+i3w_thumbnails_lookup(i3wThumbnails *thumbnails, const gchar *workspace);
+
+#endif /* !__I3W_THUMBNAILS_H__ */
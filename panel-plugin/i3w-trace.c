@@ -0,0 +1,255 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "i3w-trace.h"
+
+// a complete ("X") trace event
+typedef struct
+{
+    const gchar *name;
+    gint64 start;
+    gint64 duration;
+    gint tid;
+    gint workspaces;
+    gchar detail[I3W_TRACE_DETAIL_MAX];
+} i3wTraceSpan;
+
+typedef struct
+{
+    GMutex lock;
+    i3wTraceSpan spans[I3W_TRACE_RING_SIZE];
+    // the spans being written out, only touched by the main loop
+    i3wTraceSpan flushing[I3W_TRACE_RING_SIZE];
+    guint head;
+    guint len;
+    guint dropped;
+
+    FILE *file;
+    gint next_tid;
+} i3wTrace;
+
+// NULL unless enabled, set once by i3w_trace_init
+static i3wTrace *trace = NULL;
+
+static GPrivate trace_tid;
+
+/*
+ * Prototypes
+ */
+
+static gint
+thread_id(void);
+
+static gboolean
+on_flush_timeout(gpointer data);
+
+/*
+ * Implementations of public functions
+ */
+
+/**
+ * i3w_trace_init:
+ *
+ * Open the file named by I3W_TRACE and start flushing the spans into it.
+ * Only the first call has any effect.
+ */
+void
+i3w_trace_init(void)
+{
+    static gsize initialized = 0;
+
+    if (!g_once_init_enter(&initialized))
+        return;
+
+    const gchar *path = g_getenv("I3W_TRACE");
+    FILE *file = path && path[0] ? fopen(path, "w") : NULL;
+
+    if (file)
+    {
+        i3wTrace *t = g_new0(i3wTrace, 1);
+        g_mutex_init(&t->lock);
+        t->file = file;
+
+        // the closing bracket is optional in the trace event format
+        fputs("[\n", file);
+        fflush(file);
+
+        g_timeout_add_seconds_full(G_PRIORITY_LOW, 1, on_flush_timeout, NULL, NULL);
+        g_atomic_pointer_set(&trace, t);
+    }
+    else if (path && path[0])
+    {
+        g_printerr("Cannot open the trace file %s\n", path);
+    }
+
+    g_once_init_leave(&initialized, 1);
+}
+
+/**
+ * i3w_trace_begin:
+ *
+ * Returns: the start of a span to pass to i3w_trace_end, 0 if tracing is
+ * disabled.
+ */
+gint64
+i3w_trace_begin(void)
+{
+    return G_UNLIKELY(g_atomic_pointer_get(&trace) != NULL) ? g_get_monotonic_time() : 0;
+}
+
+/**
+ * i3w_trace_end:
+ * @name: the name of the span, a static string
+ * @start: the return value of i3w_trace_begin
+ * @detail: the event type or workspace the span is about, or NULL
+ * @workspaces: the number of workspaces, negative if unknown
+ *
+ * Record a span ending now. Safe to call from any thread; spans beyond the
+ * capacity of the ring are dropped until the next flush.
+ */
+void
+i3w_trace_end(const gchar *name, gint64 start, const gchar *detail, gint workspaces)
+{
+    i3wTrace *t = g_atomic_pointer_get(&trace);
+
+    if (G_LIKELY(!t || !start))
+        return;
+
+    gint64 end = g_get_monotonic_time();
+    gint tid = thread_id();
+
+    g_mutex_lock(&t->lock);
+    if (t->len == I3W_TRACE_RING_SIZE)
+    {
+        t->dropped++;
+    }
+    else
+    {
+        i3wTraceSpan *span = &t->spans[(t->head + t->len) % I3W_TRACE_RING_SIZE];
+        span->name = name;
+        span->start = start;
+        span->duration = end - start;
+        span->tid = tid;
+        span->workspaces = workspaces;
+        g_strlcpy(span->detail, detail ? detail : "", sizeof(span->detail));
+        t->len++;
+    }
+    g_mutex_unlock(&t->lock);
+}
+
+/**
+ * i3w_trace_flush:
+ *
+ * Write the buffered spans to the trace file. The ring is only locked while
+ * the spans are copied out. Must be called from the main loop.
+ */
+void
+i3w_trace_flush(void)
+{
+    i3wTrace *t = g_atomic_pointer_get(&trace);
+    guint len, dropped, i;
+
+    if (!t)
+        return;
+
+    i3wTraceSpan *spans = t->flushing;
+
+    g_mutex_lock(&t->lock);
+    len = t->len;
+    dropped = t->dropped;
+    for (i = 0; i < len; i++)
+        spans[i] = t->spans[(t->head + i) % I3W_TRACE_RING_SIZE];
+    t->head = (t->head + len) % I3W_TRACE_RING_SIZE;
+    t->len = 0;
+    t->dropped = 0;
+    g_mutex_unlock(&t->lock);
+
+    if (len == 0 && dropped == 0)
+        return;
+
+    GString *json = g_string_new(NULL);
+    gint pid = getpid();
+
+    for (i = 0; i < len; i++)
+    {
+        gchar *detail = g_strescape(spans[i].detail, NULL);
+
+        g_string_append_printf(json,
+                "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%" G_GINT64_FORMAT
+                ",\"dur\":%" G_GINT64_FORMAT ",\"pid\":%d,\"tid\":%d,"
+                "\"args\":{\"detail\":\"%s\",\"workspaces\":%d}},\n",
+                spans[i].name, spans[i].start, spans[i].duration, pid,
+                spans[i].tid, detail, spans[i].workspaces);
+
+        g_free(detail);
+    }
+
+    if (dropped)
+    {
+        g_string_append_printf(json,
+                "{\"name\":\"dropped\",\"ph\":\"i\",\"s\":\"p\",\"ts\":%" G_GINT64_FORMAT
+                ",\"pid\":%d,\"tid\":%d,\"args\":{\"spans\":%u}},\n",
+                g_get_monotonic_time(), pid, thread_id(), dropped);
+    }
+
+    fwrite(json->str, 1, json->len, t->file);
+    fflush(t->file);
+    g_string_free(json, TRUE);
+}
+
+/*
+ * Implementations of private functions
+ */
+
+/**
+ * thread_id:
+ *
+ * Returns: a small number identifying the calling thread in the trace
+ */
+static gint
+thread_id(void)
+{
+    gint tid = GPOINTER_TO_INT(g_private_get(&trace_tid));
+
+    if (!tid)
+    {
+        tid = g_atomic_int_add(&trace->next_tid, 1) + 1;
+        g_private_set(&trace_tid, GINT_TO_POINTER(tid));
+    }
+
+    return tid;
+}
+
+/**
+ * on_flush_timeout:
+ * @data: unused
+ *
+ * Returns: G_SOURCE_CONTINUE
+ */
+static gboolean
+on_flush_timeout(gpointer data)
+{
+    i3w_trace_flush();
+
+    return G_SOURCE_CONTINUE;
+}
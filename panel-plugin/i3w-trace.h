@@ -0,0 +1,48 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_TRACE_H__
+#define __I3W_TRACE_H__
+
+#include <glib.h>
+
+/*
+ * Opt-in tracing to a Chrome trace event file, for Perfetto or
+ * chrome://tracing. Enabled by setting I3W_TRACE to the path of the file.
+ *
+ * The spans are buffered in a fixed ring and written out by a low priority
+ * timeout of the main loop, so recording one is a clock read and a short
+ * locked copy. Disabled, a span costs a single branch.
+ */
+
+#define I3W_TRACE_RING_SIZE 4096
+#define I3W_TRACE_DETAIL_MAX 32
+
+void
+i3w_trace_init(void);
+
+gint64
+i3w_trace_begin(void);
+
+void
+i3w_trace_end(const gchar *name, gint64 start, const gchar *detail, gint workspaces);
+
+void
+i3w_trace_flush(void);
+
+#endif /* !__I3W_TRACE_H__ */
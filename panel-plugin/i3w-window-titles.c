@@ -0,0 +1,334 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unistd.h>
+
+#include <gio/gio.h>
+#include <json-glib/json-glib.h>
+
+#include "i3w-window-titles.h"
+#include "i3w-ipc-socket.h"
+
+struct _i3w_window_titles
+{
+    gint ref_count;
+    gboolean destroyed;
+
+    i3wWindowTitlesReadyCallback ready;
+    gpointer ready_data;
+
+    // workspace name => the escaped titles, one per line
+    GHashTable *cache;
+    // bumped by every invalidation, fetches started before are discarded
+    guint generation;
+    gboolean fetching;
+};
+
+/*
+ * Prototypes
+ */
+static void
+titles_unref(i3wWindowTitles *titles);
+static void
+fetch_titles(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable);
+static void
+on_titles_fetched(GObject *source, GAsyncResult *result, gpointer data);
+static void
+collect_workspaces(JsonObject *con, GHashTable *result);
+static void
+collect_titles(JsonObject *con, GString *text);
+
+/*
+ * Implementations of public functions
+ */
+
+/**
+ * i3w_window_titles_new:
+ * @ready: called when fetched titles were added to the cache
+ * @data: the data to be passed to the callback function
+ *
+ * Returns: the window title cache
+ */
+i3wWindowTitles *
+i3w_window_titles_new(i3wWindowTitlesReadyCallback ready, gpointer data)
+{
+    i3wWindowTitles *titles = g_new0(i3wWindowTitles, 1);
+
+    titles->ref_count = 1;
+    titles->ready = ready;
+    titles->ready_data = data;
+    titles->cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+    return titles;
+}
+
+/**
+ * i3w_window_titles_free:
+ * @titles: the window title cache
+ *
+ * A fetch still running is finished and dropped.
+ */
+void
+i3w_window_titles_free(i3wWindowTitles *titles)
+{
+    titles->destroyed = TRUE;
+    titles_unref(titles);
+}
+
+/**
+ * i3w_window_titles_invalidate:
+ * @titles: the window title cache
+ * @workspace: (nullable): the workspace whose windows changed, NULL for all
+ *
+ * Forget the titles of the workspace.
+ */
+void
+i3w_window_titles_invalidate(i3wWindowTitles *titles, const gchar *workspace)
+{
+    titles->generation++;
+
+    if (workspace)
+        g_hash_table_remove(titles->cache, workspace);
+    else
+        g_hash_table_remove_all(titles->cache);
+}
+
+/**
+ * i3w_window_titles_lookup:
+ * @titles: the window title cache
+ * @workspace: the workspace name
+ *
+ * Look up the titles of the workspace. When they are not cached yet a fetch
+ * is started and the ready callback runs once it is done.
+ *
+ * Returns: the escaped titles, one per line, "" for an empty workspace, NULL
+ * when not cached
+ */
+const gchar *
+i3w_window_titles_lookup(i3wWindowTitles *titles, const gchar *workspace)
+{
+    const gchar *text = g_hash_table_lookup(titles->cache, workspace);
+    if (text || titles->fetching)
+        return text;
+
+    titles->fetching = TRUE;
+    g_atomic_int_inc(&titles->ref_count);
+
+    GTask *task = g_task_new(NULL, NULL, on_titles_fetched, titles);
+    g_task_set_task_data(task, GUINT_TO_POINTER(titles->generation), NULL);
+    g_task_run_in_thread(task, fetch_titles);
+    g_object_unref(task);
+
+    return NULL;
+}
+
+/*
+ * Implementations of private functions
+ */
+
+/**
+ * titles_unref:
+ * @titles: the window title cache
+ *
+ * Drop a reference, a running fetch holds one.
+ */
+static void
+titles_unref(i3wWindowTitles *titles)
+{
+    if (!g_atomic_int_dec_and_test(&titles->ref_count))
+        return;
+
+    g_hash_table_destroy(titles->cache);
+    g_free(titles);
+}
+
+/**
+ * fetch_titles:
+ * @task: the task
+ * @source: unused
+ * @task_data: the generation of the cache when the fetch started
+ * @cancellable: unused
+ *
+ * Read the layout tree on a connection of its own, on a worker thread.
+ */
+static void
+fetch_titles(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable)
+{
+    GError *err = NULL;
+    guint32 type;
+    gchar *payload = NULL;
+
+    gchar *path = i3w_ipc_socket_path();
+    if (!path)
+    {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                "Cannot find the i3 socket");
+        return;
+    }
+
+    gint fd = i3w_ipc_connect(path, &err);
+    g_free(path);
+
+    if (fd >= 0 && i3w_ipc_send(fd, I3W_IPC_GET_TREE, "", &err))
+        payload = i3w_ipc_recv(fd, &type, &err);
+    if (fd >= 0)
+        close(fd);
+
+    if (!payload)
+    {
+        g_task_return_error(task, err);
+        return;
+    }
+
+    JsonParser *parser = json_parser_new();
+    if (!json_parser_load_from_data(parser, payload, -1, &err))
+    {
+        g_free(payload);
+        g_object_unref(parser);
+        g_task_return_error(task, err);
+        return;
+    }
+    g_free(payload);
+
+    GHashTable *result = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    JsonNode *root = json_parser_get_root(parser);
+    if (JSON_NODE_HOLDS_OBJECT(root))
+        collect_workspaces(json_node_get_object(root), result);
+    g_object_unref(parser);
+
+    g_task_return_pointer(task, result, (GDestroyNotify) g_hash_table_unref);
+}
+
+/**
+ * on_titles_fetched:
+ * @source: unused
+ * @result: the task
+ * @data: the window title cache
+ *
+ * Fill the cache, unless it was invalidated in the meantime.
+ */
+static void
+on_titles_fetched(GObject *source, GAsyncResult *result, gpointer data)
+{
+    i3wWindowTitles *titles = (i3wWindowTitles *) data;
+    guint generation = GPOINTER_TO_UINT(g_task_get_task_data(G_TASK(result)));
+    GError *err = NULL;
+
+    GHashTable *fetched = g_task_propagate_pointer(G_TASK(result), &err);
+    titles->fetching = FALSE;
+
+    if (err != NULL)
+    {
+        g_printerr("Failed to get the window titles: %s\n", err->message);
+        g_error_free(err);
+    }
+    else if (!titles->destroyed && generation == titles->generation)
+    {
+        GHashTableIter iter;
+        gpointer key, value;
+
+        g_hash_table_iter_init(&iter, fetched);
+        while (g_hash_table_iter_next(&iter, &key, &value))
+        {
+            g_hash_table_iter_steal(&iter);
+            g_hash_table_replace(titles->cache, key, value);
+        }
+    }
+
+    if (fetched)
+        g_hash_table_unref(fetched);
+
+    if (!titles->destroyed && titles->ready)
+        titles->ready(titles, titles->ready_data);
+
+    titles_unref(titles);
+}
+
+/**
+ * collect_workspaces:
+ * @con: a container of the layout tree
+ * @result: workspace name => the escaped titles
+ *
+ * Find the workspaces under the container and collect their titles.
+ */
+static void
+collect_workspaces(JsonObject *con, GHashTable *result)
+{
+    if (g_strcmp0(i3w_ipc_json_string(con, "type"), "workspace") == 0)
+    {
+        GString *text = g_string_new(NULL);
+        collect_titles(con, text);
+        g_hash_table_replace(result, g_strdup(i3w_ipc_json_string(con, "name")),
+                g_string_free(text, FALSE));
+        return;
+    }
+
+    JsonNode *nodes = json_object_get_member(con, "nodes");
+    if (!nodes || !JSON_NODE_HOLDS_ARRAY(nodes))
+        return;
+
+    JsonArray *array = json_node_get_array(nodes);
+    guint i;
+    for (i = 0; i < json_array_get_length(array); i++)
+    {
+        JsonNode *child = json_array_get_element(array, i);
+        if (JSON_NODE_HOLDS_OBJECT(child))
+            collect_workspaces(json_node_get_object(child), result);
+    }
+}
+
+/**
+ * collect_titles:
+ * @con: a container of the layout tree
+ * @text: the escaped titles, one per line
+ *
+ * Append the titles of all the windows under the container, tiling and
+ * floating.
+ */
+static void
+collect_titles(JsonObject *con, GString *text)
+{
+    static const gchar *members[] = { "nodes", "floating_nodes" };
+    guint m, i;
+
+    JsonNode *window = json_object_get_member(con, "window");
+    if (window && !JSON_NODE_HOLDS_NULL(window))
+    {
+        gchar *escaped = g_markup_escape_text(i3w_ipc_json_string(con, "name"), -1);
+        if (text->len)
+            g_string_append_c(text, '\n');
+        g_string_append(text, escaped);
+        g_free(escaped);
+        return;
+    }
+
+    for (m = 0; m < G_N_ELEMENTS(members); m++)
+    {
+        JsonNode *nodes = json_object_get_member(con, members[m]);
+        if (!nodes || !JSON_NODE_HOLDS_ARRAY(nodes))
+            continue;
+
+        JsonArray *array = json_node_get_array(nodes);
+        for (i = 0; i < json_array_get_length(array); i++)
+        {
+            JsonNode *child = json_array_get_element(array, i);
+            if (JSON_NODE_HOLDS_OBJECT(child))
+                collect_titles(json_node_get_object(child), text);
+        }
+    }
+}
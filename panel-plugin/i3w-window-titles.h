@@ -0,0 +1,46 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_WINDOW_TITLES_H__
+#define __I3W_WINDOW_TITLES_H__
+
+#include <glib.h>
+
+/*
+ * The titles of the windows on each workspace, for the button tooltips.
+ * Nothing is fetched until a tooltip asks for it; the layout tree is then
+ * read on a worker thread and kept until invalidated by window events.
+ */
+
+typedef struct _i3w_window_titles i3wWindowTitles;
+
+typedef void (*i3wWindowTitlesReadyCallback) (i3wWindowTitles *titles, gpointer data);
+
+i3wWindowTitles *
+i3w_window_titles_new(i3wWindowTitlesReadyCallback ready, gpointer data);
+
+void
+i3w_window_titles_free(i3wWindowTitles *titles);
+
+void
+i3w_window_titles_invalidate(i3wWindowTitles *titles, const gchar *workspace);
+
+const gchar *
+i3w_window_titles_lookup(i3wWindowTitles *titles, const gchar *workspace);
+
+#endif /* !__I3W_WINDOW_TITLES_H__ */
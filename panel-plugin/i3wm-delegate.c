@@ -22,12 +22,25 @@
 #include <string.h>
 
 #include "i3wm-delegate.h"
+#include "i3w-probes.h"
+#include "i3w-stats.h"
+#include "i3w-trace.h"
+#include "i3w-ipc-socket.h"
+
+typedef struct _i3window
+{
+    gint64 id;
+    gchar *app;
+    gchar *workspace;
+} i3window;
 
 /*
  * Prototypes
  */
 static void
 destroy_workspace(i3workspace *workspace);
+static void
+destroy_window(i3window *window);
 
 long
 ws_name_to_number(const char *name);
@@ -40,31 +53,72 @@ workspace_reply_str_cmp(const i3ipcWorkspaceReply *w, const gchar *s);
 static gint
 workspace_str_cmp(const i3workspace *w, const gchar *s);
 
-static void
+static i3workspace *
+create_shm_workspace(const i3wShmModel *model, const i3wShmWorkspace *shm_workspace);
+
+static gboolean
 init_workspaces(i3windowManager *i3wm, GError **err);
+static gboolean
+publish_workspaces(i3windowManager *i3wm, GSList *wlist);
+static gboolean
+workspace_equal(const i3workspace *a, const i3workspace *b);
+static void
+count_workspace_windows(i3windowManager *i3wm, GSList *wlist);
+static gchar *
+connection_socket_path(i3windowManager *i3wm);
+static void
+open_helper(i3windowManager *i3wm, GError **err);
 static void
 subscribe_to_events(i3windowManager *i3w, GError **err);
+static i3ipcEvent
+wanted_events(i3windowManager *i3wm);
+static gboolean
+update_subscriptions(i3windowManager *i3wm, GError **err);
+static void
+connect_signals(i3windowManager *i3wm);
 
 static void
 invoke_callback(const i3wmCallback callback);
 
 /*
- * Workspace event handlers
+ * Window tracking
  */
 static void
-on_workspace_event(i3ipcConnection *conn, i3ipcWorkspaceEvent *e, gpointer i3w);
+init_windows(i3windowManager *i3wm);
+static void
+clear_windows(i3windowManager *i3wm);
+static gboolean
+add_window(i3windowManager *i3wm, gint64 id, const gchar *app, const gchar *workspace);
+static gchar *
+remove_window(i3windowManager *i3wm, gint64 id);
+static void
+add_con_windows(i3windowManager *i3wm, i3ipcCon *con, GHashTable *changed);
+static gchar *
+window_workspace(i3windowManager *i3wm, gint64 id);
 static void
-on_focus_workspace(i3windowManager *i3w, i3ipcCon *current, i3ipcCon *old);
+track_window_event(i3windowManager *i3wm, i3ipcWindowEvent *e);
+static void
+on_window_event(i3ipcConnection *conn, i3ipcWindowEvent *e, gpointer i3w);
+
+/*
+ * Workspace event handlers
+ */
 static void
-on_init_workspace(i3windowManager *i3w);
+on_workspace_event(i3ipcConnection *conn, i3ipcWorkspaceEvent *e, gpointer i3w);
+static gint
+workspace_event_type(const gchar *change);
 static void
-on_empty_workspace(i3windowManager *i3w);
+enqueue_event(i3windowManager *i3wm, i3wmEventType type, const gchar *workspace);
 static void
-on_urgent_workspace(i3windowManager *i3w);
+enqueue_resync(i3windowManager *i3wm);
 static void
-on_rename_workspace(i3windowManager *i3w);
+clear_event_queue(i3windowManager *i3wm);
 static void
-on_move_workspace(i3windowManager *i3w);
+format_queue_stats(GString *text, gpointer i3w);
+static gboolean
+process_event_queue(gpointer i3w);
+static i3wmCallback *
+event_callback(i3windowManager *i3wm, i3wmEventType type);
 
 /*
  * Mode event handler
@@ -78,21 +132,52 @@ on_mode_event(i3ipcConnection *conn, i3ipcGenericEvent *e, gpointer i3w);
 static void
 on_output_event(i3ipcConnection *conn, i3ipcGenericEvent *e, gpointer i3w);
 
+/*
+ * Bar configuration
+ */
+static void
+fetch_bar_colors(i3windowManager *i3wm, GError **err);
+static void
+on_barconfig_update_event(i3ipcConnection *conn, i3ipcBarconfigUpdateEvent *e, gpointer i3w);
+
+/*
+ * Ingestion thread handler
+ */
+static void
+on_ingest_record(const i3wIngestRecord *record, gpointer i3w);
+
+/*
+ * Workspace helper handler
+ */
+static void
+on_shm_changed(gpointer i3w);
+
 static void
 on_ipc_shutdown_proxy(i3ipcConnection *connection, gpointer i3w);
 
+/*
+ * Event names, indexed by i3wmEventType.
+ */
+static const gchar *event_names[I3WM_EVENT_COUNT] =
+{
+    "focus", "init", "empty", "move", "output", "urgent", "rename"
+};
+
 /*
  * Implementations of public functions
  */
 
 /**
  * i3wm_construct:
+ * @event_source: where to get the workspace, mode and output events from
  * @err: The error object
  *
- * Construct the i3 windowmanager delegate struct.
+ * Construct the i3 windowmanager delegate struct. With the workspace helper,
+ * the helper is started if it is not running yet and this fails with
+ * G_IO_ERROR_PENDING until it is up.
  */
 i3windowManager *
-i3wm_construct(GError **err)
+i3wm_construct(i3wmEventSource event_source, GError **err)
 {
     i3windowManager *i3wm = g_new0(i3windowManager, 1);
     GError *tmp_err = NULL;
@@ -105,9 +190,12 @@ i3wm_construct(GError **err)
         return NULL;
     }
 
-    g_signal_connect(i3wm->connection, "ipc-shutdown", G_CALLBACK(on_ipc_shutdown_proxy), i3wm);
+    connect_signals(i3wm);
 
-    i3wm->wlist = NULL;
+    i3wm->workspaces = g_new0(i3wmWorkspaces, 1);
+    i3wm->workspaces->ref_count = 1;
+    i3wm->event_source = event_source;
+    i3w_stats_add_source(format_queue_stats, i3wm);
 
     i3wm->on_workspace_created.function = NULL;
     i3wm->on_workspace_destroyed.function = NULL;
@@ -116,6 +204,17 @@ i3wm_construct(GError **err)
     i3wm->on_workspace_urgent.function = NULL;
     i3wm->on_ipc_shutdown = NULL;
 
+    if (event_source == I3WM_EVENTS_HELPER)
+    {
+        open_helper(i3wm, &tmp_err);
+        if (tmp_err != NULL)
+        {
+            g_propagate_error(err, tmp_err);
+            i3wm_destruct(i3wm);
+            return NULL;
+        }
+    }
+
     init_workspaces(i3wm, &tmp_err);
     if(tmp_err != NULL)
     {
@@ -143,9 +242,29 @@ i3wm_construct(GError **err)
 void
 i3wm_destruct(i3windowManager *i3wm)
 {
+    i3w_stats_remove_source(format_queue_stats, i3wm);
+    if (i3wm->ingest)
+        i3w_ingest_stop(i3wm->ingest);
+    g_free(i3wm->ingest_model);
+    if (i3wm->shm)
+        i3w_shm_close(i3wm->shm);
+    g_free(i3wm->shm_model);
+    if (i3wm->latency)
+        i3w_latency_free(i3wm->latency);
+
+    if (i3wm->event_queue_idle)
+        g_source_remove(i3wm->event_queue_idle);
+    clear_event_queue(i3wm);
+
     g_object_unref(i3wm->connection);
 
-    g_slist_free_full(i3wm->wlist, (GDestroyNotify) destroy_workspace);
+    i3wm_unref_workspaces(i3wm->workspaces);
+
+    clear_windows(i3wm);
+
+    g_free(i3wm->bar_id);
+    if (i3wm->bar_colors)
+        g_hash_table_destroy(i3wm->bar_colors);
 
     g_free(i3wm);
 }
@@ -153,14 +272,48 @@ i3wm_destruct(i3windowManager *i3wm)
 /**
  * i3wm_get_workspaces:
  * @i3wm: the window manager delegate struct
- * Returns the workspaces array.
+ * Returns the workspaces array. It is only valid until the next update,
+ * use i3wm_ref_workspaces to keep it longer.
  *
  * Returns: GSList* of i3workspace*
  */
 GSList *
 i3wm_get_workspaces(i3windowManager *i3wm)
 {
-    return i3wm->wlist;
+    return i3wm->workspaces->wlist;
+}
+
+/**
+ * i3wm_ref_workspaces:
+ * @i3wm: the window manager delegate struct
+ *
+ * Take a reference to the current snapshot of the workspaces. It stays
+ * valid, and unchanged, after the delegate published newer ones or was
+ * destructed.
+ *
+ * Returns: the snapshot, release it with i3wm_unref_workspaces
+ */
+i3wmWorkspaces *
+i3wm_ref_workspaces(i3windowManager *i3wm)
+{
+    i3wm->workspaces->ref_count++;
+    return i3wm->workspaces;
+}
+
+/**
+ * i3wm_unref_workspaces:
+ * @workspaces: a snapshot of the workspaces
+ *
+ * Release a reference to the snapshot, freeing it with the last one.
+ */
+void
+i3wm_unref_workspaces(i3wmWorkspaces *workspaces)
+{
+    if (--workspaces->ref_count > 0)
+        return;
+
+    g_slist_free_full(workspaces->wlist, (GDestroyNotify) destroy_workspace);
+    g_free(workspaces);
 }
 
 /*
@@ -177,6 +330,218 @@ i3wm_workspace_cmp(const i3workspace *a, const i3workspace *b)
     return workspace_name_cmp(a->name, b->name);
 }
 
+/**
+ * i3wm_set_count_windows:
+ * @i3wm: the window manager delegate struct
+ * @count_windows: whether to count the windows on the workspaces
+ * @err: the error object
+ *
+ * Counting the windows needs the whole layout tree, so it is only done when
+ * some consumer actually needs the i3workspace.windows field. The counts are
+ * refreshed on the window events which open, close or move a window.
+ */
+void
+i3wm_set_count_windows(i3windowManager *i3wm, gboolean count_windows, GError **err)
+{
+    if (i3wm->count_windows == count_windows)
+        return;
+
+    i3wm->count_windows = count_windows;
+    if (!update_subscriptions(i3wm, err))
+    {
+        i3wm->count_windows = !count_windows;
+        return;
+    }
+
+    // the published snapshot cannot be filled in, publish a new one
+    if (count_windows)
+        init_workspaces(i3wm, err);
+}
+
+/**
+ * i3wm_get_queue_stats:
+ * @i3wm: the window manager delegate struct
+ *
+ * Returns: the counters of the event queue
+ */
+const i3wmQueueStats *
+i3wm_get_queue_stats(i3windowManager *i3wm)
+{
+    return &i3wm->queue_stats;
+}
+
+/**
+ * i3wm_event_type_name:
+ * @type: the event type
+ *
+ * Returns: the i3 name of the event type
+ */
+const gchar *
+i3wm_event_type_name(i3wmEventType type)
+{
+    return type < I3WM_EVENT_COUNT ? event_names[type] : "unknown";
+}
+
+/**
+ * i3wm_set_track_windows:
+ * @i3wm: the window manager delegate struct
+ * @track_windows: whether to track the windows of the workspaces
+ * @err: the error object
+ *
+ * Start or stop tracking which applications have windows on which
+ * workspace. The window events are only subscribed to while some feature
+ * needs them.
+ */
+void
+i3wm_set_track_windows(i3windowManager *i3wm, gboolean track_windows, GError **err)
+{
+    if (i3wm->track_windows == track_windows)
+        return;
+
+    i3wm->track_windows = track_windows;
+    if (!update_subscriptions(i3wm, err))
+    {
+        i3wm->track_windows = !track_windows;
+        return;
+    }
+
+    if (track_windows)
+        init_windows(i3wm);
+    else
+        clear_windows(i3wm);
+}
+
+/**
+ * i3wm_set_watch_window_titles:
+ * @i3wm: the window manager delegate struct
+ * @watch: whether to report the window changes visible in the titles
+ * @err: the error object
+ *
+ * Start or stop reporting the window events which change the window titles
+ * of a workspace, see i3wm_set_on_window_titles_changed().
+ */
+void
+i3wm_set_watch_window_titles(i3windowManager *i3wm, gboolean watch, GError **err)
+{
+    if (i3wm->watch_window_titles == watch)
+        return;
+
+    i3wm->watch_window_titles = watch;
+    if (!update_subscriptions(i3wm, err))
+        i3wm->watch_window_titles = !watch;
+}
+
+/**
+ * i3wm_set_latency_probe_interval:
+ * @i3wm: the window manager delegate struct
+ * @interval: seconds between the tick probes, 0 to disable them
+ * @err: the error object
+ *
+ * Periodically measure the round trip of a tick through i3, see
+ * i3w-latency.h.
+ */
+void
+i3wm_set_latency_probe_interval(i3windowManager *i3wm, guint interval, GError **err)
+{
+    if (i3wm->latency_probe_interval == interval)
+        return;
+
+    if (i3wm->latency)
+    {
+        i3w_latency_free(i3wm->latency);
+        i3wm->latency = NULL;
+    }
+    i3wm->latency_probe_interval = 0;
+
+    if (!interval)
+        return;
+
+    gchar *path = connection_socket_path(i3wm);
+    if (!path)
+    {
+        g_set_error(err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "Cannot find the i3 socket");
+        return;
+    }
+
+    i3wm->latency = i3w_latency_new(path, interval, err);
+    if (i3wm->latency)
+        i3wm->latency_probe_interval = interval;
+    g_free(path);
+}
+
+/**
+ * i3wm_set_watch_bar_config:
+ * @i3wm: the window manager delegate struct
+ * @watch: whether to follow the bar configuration
+ * @err: the error object
+ *
+ * Read the colors of the first bar and read them again on every bar
+ * configuration update, see i3wm_set_on_bar_config_changed().
+ */
+void
+i3wm_set_watch_bar_config(i3windowManager *i3wm, gboolean watch, GError **err)
+{
+    if (i3wm->watch_bar_config == watch)
+        return;
+
+    i3wm->watch_bar_config = watch;
+    if (!update_subscriptions(i3wm, err))
+    {
+        i3wm->watch_bar_config = !watch;
+        return;
+    }
+
+    if (watch)
+    {
+        fetch_bar_colors(i3wm, err);
+    }
+    else if (i3wm->bar_colors)
+    {
+        g_hash_table_destroy(i3wm->bar_colors);
+        i3wm->bar_colors = NULL;
+    }
+}
+
+/**
+ * i3wm_get_bar_colors:
+ * @i3wm: the window manager delegate struct
+ *
+ * Returns the colors set in the colors block of the bar, keyed by the names
+ * used by the GET_BAR_CONFIG reply, such as focused_workspace_bg. Colors
+ * not set in the i3 config are missing.
+ *
+ * Returns: GHashTable* of gchar* => gchar*, owned by the delegate, NULL when
+ * the bar configuration is not watched or not known
+ */
+GHashTable *
+i3wm_get_bar_colors(i3windowManager *i3wm)
+{
+    return i3wm->bar_colors;
+}
+
+/**
+ * i3wm_get_workspace_apps:
+ * @i3wm: the window manager delegate struct
+ * @workspace: the name of the workspace
+ *
+ * Returns the window classes of the applications on the workspace, each
+ * class listed once no matter how many windows it has there.
+ *
+ * Returns: GList* of const gchar*, free the list with g_list_free()
+ */
+GList *
+i3wm_get_workspace_apps(i3windowManager *i3wm, const gchar *workspace)
+{
+    if (!i3wm->workspace_apps)
+        return NULL;
+
+    GHashTable *apps = g_hash_table_lookup(i3wm->workspace_apps, workspace);
+    if (!apps)
+        return NULL;
+
+    return g_list_sort(g_hash_table_get_keys(apps), (GCompareFunc) g_strcmp0);
+}
+
 /**
  * i3wm_set_on_workspace_created:
  * @i3wm: the window manager delegate struct
@@ -297,6 +662,57 @@ i3wm_set_on_output_changed(i3windowManager *i3wm, i3wmOutputCallback_fun callbac
     i3wm->on_output_changed.data = data;
 }
 
+/**
+ * i3wm_set_on_workspace_windows_changed:
+ * @i3wm: the window manager delegate struct
+ * @callback: the callback
+ * @data: the data to be passed to the callback function
+ *
+ * Set the callback invoked when the set of applications on a workspace
+ * changes.
+ */
+void
+i3wm_set_on_workspace_windows_changed(i3windowManager *i3wm,
+        i3wmWindowsCallback_fun callback, gpointer data)
+{
+    i3wm->on_workspace_windows_changed.function = callback;
+    i3wm->on_workspace_windows_changed.data = data;
+}
+
+/**
+ * i3wm_set_on_bar_config_changed:
+ * @i3wm: the window manager delegate struct
+ * @callback: the callback
+ * @data: the data to be passed to the callback function
+ *
+ * Set the callback invoked when the bar configuration was updated, after
+ * its colors have been read again.
+ */
+void
+i3wm_set_on_bar_config_changed(i3windowManager *i3wm,
+        i3wmWorkspaceCallback callback, gpointer data)
+{
+    i3wm->on_bar_config_changed.function = callback;
+    i3wm->on_bar_config_changed.data = data;
+}
+
+/**
+ * i3wm_set_on_window_titles_changed:
+ * @i3wm: the window manager delegate struct
+ * @callback: the callback
+ * @data: the data to be passed to the callback function
+ *
+ * Set the callback invoked when a window of a workspace appears, disappears
+ * or changes its title. The workspace is NULL when it is not known.
+ */
+void
+i3wm_set_on_window_titles_changed(i3windowManager *i3wm,
+        i3wmWindowsCallback_fun callback, gpointer data)
+{
+    i3wm->on_window_titles_changed.function = callback;
+    i3wm->on_window_titles_changed.data = data;
+}
+
 /**
  * i3wm_set_ipc_shutdown:
  * @i3wm: the window manager delegate struct
@@ -316,34 +732,42 @@ i3wm_set_on_ipc_shutdown(i3windowManager *i3wm,
 /**
  * i3wm_goto_workspace:
  * @i3wm: the window manager delegate struct
- * @workspace: the workspace to jump to
+ * @workspace: the name of the workspace to jump to
+ * @err: the error object
  *
- * Instruct the window manager to jump to the specified workspace.
+ * Instruct the window manager to jump to the specified workspace. A command
+ * rejected by i3 is reported as an error too.
  */
 void
-i3wm_goto_workspace(i3windowManager *i3wm, i3workspace *workspace, GError **err)
+i3wm_goto_workspace(i3windowManager *i3wm, const gchar *workspace, GError **err)
 {
-    size_t cmd_size = (13 + strlen(workspace->name)) * sizeof(gchar);
-    gchar *command_str = (gchar *) malloc(cmd_size);
-    memset(command_str, 0, cmd_size);
-    sprintf(command_str, "workspace \"%s\"", workspace->name);
+    gchar *command_str = g_strdup_printf("workspace \"%s\"", workspace);
 
     GError *ipc_err = NULL;
 
-    gchar *reply = i3ipc_connection_message(
-            i3wm->connection,
-            I3IPC_MESSAGE_TYPE_COMMAND,
-            command_str,
-            &ipc_err);
+    I3W_PROBE1(command_send, workspace);
+
+    gint64 start = g_get_monotonic_time();
+    gint64 trace = i3w_trace_begin();
+    GSList *replies = i3ipc_connection_command(i3wm->connection, command_str, &ipc_err);
+    i3w_trace_end("command", trace, workspace, i3wm->workspace_count);
+    i3w_stats_record(I3W_TIMING_IPC_ROUND_TRIP, start);
+
+    I3W_PROBE2(command_reply, workspace, ipc_err == NULL);
 
     if (ipc_err != NULL)
     {
         g_propagate_error(err, ipc_err);
     }
-    else
+    else if (replies && !((i3ipcCommandReply *) replies->data)->success)
     {
-        g_free(reply);
+        i3ipcCommandReply *reply = (i3ipcCommandReply *) replies->data;
+        g_set_error(err, G_IO_ERROR, G_IO_ERROR_FAILED, "%s: %s", command_str,
+                reply->error ? reply->error : "failed");
     }
+
+    g_slist_free_full(replies, (GDestroyNotify) i3ipc_command_reply_free);
+    g_free(command_str);
 }
 
 /*
@@ -369,6 +793,35 @@ create_workspace(i3ipcWorkspaceReply * wreply)
     workspace->visible = wreply->visible;
     workspace->urgent = wreply->urgent;
     workspace->output = g_strdup(wreply->output);
+    workspace->windows = 0;
+
+    i3w_stats_add(I3W_STAT_LIVE_WORKSPACES, 1);
+
+    return workspace;
+}
+
+/**
+ * create_shm_workspace:
+ * @shm_workspace: the workspace in the model of the helper
+ *
+ * Create a i3workspace struct from the model of the workspace helper
+ *
+ * Returns: the created workspace
+ */
+static i3workspace *
+create_shm_workspace(const i3wShmModel *model, const i3wShmWorkspace *shm_workspace)
+{
+    i3workspace *workspace = (i3workspace *) g_malloc(sizeof(i3workspace));
+
+    workspace->num = shm_workspace->num;
+    workspace->name = g_strdup(i3w_shm_model_workspace_name(model, shm_workspace));
+    workspace->focused = (shm_workspace->flags & I3W_SHM_FOCUSED) != 0;
+    workspace->visible = (shm_workspace->flags & I3W_SHM_VISIBLE) != 0;
+    workspace->urgent = (shm_workspace->flags & I3W_SHM_URGENT) != 0;
+    workspace->output = g_strdup(shm_workspace->output);
+    workspace->windows = 0;
+
+    i3w_stats_add(I3W_STAT_LIVE_WORKSPACES, 1);
 
     return workspace;
 }
@@ -385,6 +838,22 @@ destroy_workspace(i3workspace *workspace)
     g_free(workspace->name);
     g_free(workspace->output);
     g_free(workspace);
+
+    i3w_stats_add(I3W_STAT_LIVE_WORKSPACES, -1);
+}
+
+/**
+ * destroy_window:
+ * @window: the window to destroy
+ *
+ * Destroys the window
+ */
+static void
+destroy_window(i3window *window)
+{
+    g_free(window->app);
+    g_free(window->workspace);
+    g_free(window);
 }
 
 /*
@@ -493,81 +962,409 @@ workspace_str_cmp(const i3workspace *w, const gchar *s)
  * @i3wm: the window manager delegate struct
  * @err: the error object
  *
- * Initialize the workspace list.
+ * Initialize the workspace list, from the last model read from the workspace
+ * helper or queried by the ingestion thread when there is one. Only without
+ * them the main loop waits for i3.
+ *
+ * Returns: whether anything the consumers see changed
  */
-void
+static gboolean
 init_workspaces(i3windowManager *i3wm, GError **err)
 {
-    if (i3wm->wlist) {
-        g_slist_free_full(i3wm->wlist, (GDestroyNotify) destroy_workspace);
-    }
+    I3W_PROBE1(model_update_start, i3wm->workspace_count);
+    gint64 start = g_get_monotonic_time();
+    gint64 trace = i3w_trace_begin();
 
-    i3wm->wlist = NULL;
-
-    GError *get_err = NULL;
-    GSList *wlist = i3ipc_connection_get_workspaces(i3wm->connection, &get_err);
+    GSList *wlist = NULL;
+    guint workspace_count = 0;
 
-    if (get_err != NULL)
+    if (i3wm->ingest)
     {
-        g_propagate_error(err, get_err);
-        return;
+        i3wShmModel *taken = i3w_ingest_take_workspaces(i3wm->ingest);
+        if (taken)
+        {
+            g_free(i3wm->ingest_model);
+            i3wm->ingest_model = taken;
+        }
     }
 
-    GSList *witem;
-    for (witem = wlist; witem != NULL; witem = witem->next)
+    const i3wShmModel *model = i3wm->shm ? i3wm->shm_model : i3wm->ingest_model;
+
+    if (model)
+    {
+        guint i;
+        for (i = 0; i < model->n_workspaces; i++)
+        {
+            i3workspace *workspace = create_shm_workspace(model, &model->workspaces[i]);
+            wlist = g_slist_prepend(wlist, workspace);
+            workspace_count++;
+        }
+    }
+    else
     {
-        i3workspace *workspace = create_workspace((i3ipcWorkspaceReply *) witem->data);
-        i3wm->wlist = g_slist_prepend(i3wm->wlist, workspace);
+        GError *get_err = NULL;
+        gint64 ipc_start = g_get_monotonic_time();
+        GSList *replies = i3ipc_connection_get_workspaces(i3wm->connection, &get_err);
+        i3w_stats_record(I3W_TIMING_IPC_ROUND_TRIP, ipc_start);
+
+        if (get_err != NULL)
+        {
+            I3W_PROBE1(model_update_end, i3wm->workspace_count);
+            i3w_stats_record(I3W_TIMING_MODEL_UPDATE, start);
+            i3w_trace_end("init_workspaces", trace, "failed", i3wm->workspace_count);
+            g_propagate_error(err, get_err);
+            return FALSE;
+        }
+
+        GSList *witem;
+        for (witem = replies; witem != NULL; witem = witem->next)
+        {
+            i3workspace *workspace = create_workspace((i3ipcWorkspaceReply *) witem->data);
+            wlist = g_slist_prepend(wlist, workspace);
+            workspace_count++;
+        }
+
+        g_slist_free_full(replies, (GDestroyNotify) i3ipc_workspace_reply_free);
     }
 
-    i3wm->wlist = g_slist_reverse(i3wm->wlist);
-    i3wm->wlist = g_slist_sort(i3wm->wlist, (GCompareFunc) i3wm_workspace_cmp);
+    wlist = g_slist_reverse(wlist);
+    wlist = g_slist_sort(wlist, (GCompareFunc) i3wm_workspace_cmp);
 
-    g_slist_free_full(wlist, (GDestroyNotify) i3ipc_workspace_reply_free);
+    if (i3wm->count_windows)
+        count_workspace_windows(i3wm, wlist);
+
+    i3wm->workspace_count = workspace_count;
+    gboolean changed = publish_workspaces(i3wm, wlist);
+
+    I3W_PROBE1(model_update_end, i3wm->workspace_count);
+    i3w_stats_record(I3W_TIMING_MODEL_UPDATE, start);
+    i3w_trace_end("init_workspaces", trace,
+            !changed ? "unchanged" : i3wm->shm ? "helper" : model ? "ingest" : NULL,
+            i3wm->workspace_count);
+
+    return changed;
 }
 
 /**
- * subscribe_to_events:
+ * publish_workspaces:
  * @i3wm: the window manager delegate struct
- * @err: the error object
+ * @wlist: the new workspaces, sorted by name
+ *
+ * Replace the current snapshot by a new one with the workspaces. The
+ * workspaces which did not change since the previous snapshot keep their
+ * generation, the others get the generation of the new snapshot. When none
+ * of them changed and none is gone, the previous snapshot stays current and
+ * the new list is dropped.
  *
- * Subscribe to the workspace events.
+ * Returns: whether a new snapshot was published
  */
-void
-subscribe_to_events(i3windowManager *i3wm, GError **err)
+static gboolean
+publish_workspaces(i3windowManager *i3wm, GSList *wlist)
 {
-    GError *ipc_err = NULL;
-    i3ipcCommandReply *reply = NULL;
+    // shared by all the delegates, so a reconnect does not reuse generations
+    static guint64 last_generation = 0;
 
-	// subscribe to workspace changes
-    reply = i3ipc_connection_subscribe(i3wm->connection, I3IPC_EVENT_WORKSPACE, &ipc_err);
-    if (ipc_err != NULL)
+    i3wmWorkspaces *previous = i3wm->workspaces;
+    guint64 generation = last_generation + 1;
+    gboolean changed = g_slist_length(wlist) != g_slist_length(previous->wlist);
+
+    // both lists are sorted by name, walk them side by side
+    GSList *witem, *pitem = previous->wlist;
+    for (witem = wlist; witem != NULL; witem = witem->next)
     {
-        g_propagate_error(err, ipc_err);
+        i3workspace *workspace = (i3workspace *) witem->data;
+        gint cmp = 1;
+
+        while (pitem && (cmp = i3wm_workspace_cmp(pitem->data, workspace)) < 0)
+            pitem = pitem->next;
+
+        if (pitem && cmp == 0 && workspace_equal(pitem->data, workspace))
+        {
+            workspace->generation = ((i3workspace *) pitem->data)->generation;
+        }
+        else
+        {
+            workspace->generation = generation;
+            changed = TRUE;
+        }
+    }
+
+    if (!changed)
+    {
+        g_slist_free_full(wlist, (GDestroyNotify) destroy_workspace);
+        return FALSE;
+    }
+
+    i3wmWorkspaces *workspaces = g_new0(i3wmWorkspaces, 1);
+    workspaces->ref_count = 1;
+    workspaces->generation = last_generation = generation;
+    workspaces->wlist = wlist;
+
+    i3wm->workspaces = workspaces;
+    i3wm_unref_workspaces(previous);
+
+    return TRUE;
+}
+
+/**
+ * workspace_equal:
+ * @a: a workspace
+ * @b: another workspace
+ *
+ * Returns: whether the two workspaces are in the same state
+ */
+static gboolean
+workspace_equal(const i3workspace *a, const i3workspace *b)
+{
+    return a->num == b->num &&
+        a->focused == b->focused &&
+        a->urgent == b->urgent &&
+        a->visible == b->visible &&
+        a->windows == b->windows &&
+        g_strcmp0(a->name, b->name) == 0 &&
+        g_strcmp0(a->output, b->output) == 0;
+}
+
+/**
+ * count_workspace_windows:
+ * @i3wm: the window manager delegate struct
+ * @wlist: the workspaces being built
+ *
+ * Fill in the window count of the workspaces from the layout tree.
+ */
+static void
+count_workspace_windows(i3windowManager *i3wm, GSList *wlist)
+{
+    GError *tree_err = NULL;
+    gint64 start = g_get_monotonic_time();
+    i3ipcCon *tree = i3ipc_connection_get_tree(i3wm->connection, &tree_err);
+    i3w_stats_record(I3W_TIMING_IPC_ROUND_TRIP, start);
+
+    if (tree_err != NULL)
+    {
+        g_printf("Failed to get the layout tree: %s\n", tree_err->message);
+        g_error_free(tree_err);
         return;
     }
 
-	// subscribe to mode changes
-    reply = i3ipc_connection_subscribe(i3wm->connection, I3IPC_EVENT_MODE, &ipc_err);
-    if (ipc_err != NULL)
+    GList *cons = i3ipc_con_workspaces(tree);
+    GList *citem;
+    for (citem = cons; citem != NULL; citem = citem->next)
     {
-        g_propagate_error(err, ipc_err);
+        i3ipcCon *con = (i3ipcCon *) citem->data;
+        const gchar *name = i3ipc_con_get_name(con);
+
+        GSList *witem;
+        for (witem = wlist; witem != NULL; witem = witem->next)
+        {
+            i3workspace *workspace = (i3workspace *) witem->data;
+            if (g_strcmp0(workspace->name, name) == 0)
+            {
+                GList *leaves = i3ipc_con_leaves(con);
+                workspace->windows = g_list_length(leaves);
+                g_list_free(leaves);
+                break;
+            }
+        }
+    }
+
+    g_list_free(cons);
+    g_object_unref(tree);
+}
+
+/**
+ * connection_socket_path:
+ * @i3wm: the window manager delegate struct
+ *
+ * Returns: the socket path of the i3ipc-glib connection or NULL, free with
+ * g_free()
+ */
+static gchar *
+connection_socket_path(i3windowManager *i3wm)
+{
+    gchar *path = NULL;
+
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(i3wm->connection), "socket-path"))
+        g_object_get(i3wm->connection, "socket-path", &path, NULL);
+    if (!path)
+        path = i3w_ipc_socket_path();
+
+    return path;
+}
+
+/**
+ * open_helper:
+ * @i3wm: the window manager delegate struct
+ * @err: the error object
+ *
+ * Map the region of the workspace helper and read the model. When the
+ * helper is not running it is started, and this fails with
+ * G_IO_ERROR_PENDING; the caller is expected to retry.
+ */
+static void
+open_helper(i3windowManager *i3wm, GError **err)
+{
+    GError *tmp_err = NULL;
+
+    gchar *path = connection_socket_path(i3wm);
+    if (!path)
+    {
+        g_set_error(err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "Cannot find the i3 socket");
         return;
     }
 
-	// subscribe to output changes
-    reply = i3ipc_connection_subscribe(i3wm->connection, I3IPC_EVENT_OUTPUT, &ipc_err);
-    if (ipc_err != NULL)
+    gchar *name = i3w_shm_name(path);
+    i3wm->shm = i3w_shm_open(name, &tmp_err);
+    g_free(name);
+
+    if (g_error_matches(tmp_err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
     {
-        g_propagate_error(err, ipc_err);
+        gchar *argv[] = { HELPERDIR "/xfce4-i3-workspaces-helper", path, NULL };
+
+        g_clear_error(&tmp_err);
+        if (g_spawn_async(NULL, argv, NULL, G_SPAWN_STDOUT_TO_DEV_NULL, NULL, NULL, NULL, &tmp_err))
+            g_set_error(&tmp_err, G_IO_ERROR, G_IO_ERROR_PENDING,
+                    "Started the workspace helper");
+    }
+    g_free(path);
+
+    if (tmp_err != NULL)
+    {
+        g_propagate_error(err, tmp_err);
+        return;
+    }
+
+    i3wm->shm_model = g_new0(i3wShmModel, 1);
+    if (!i3w_shm_read(i3wm->shm, i3wm->shm_model, &i3wm->shm_generation))
+        g_set_error(err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                "The workspace helper is not running");
+}
+
+/**
+ * subscribe_to_events:
+ * @i3wm: the window manager delegate struct
+ * @err: the error object
+ *
+ * Subscribe to the workspace events, on the connection, the ingestion thread
+ * or the workspace helper, depending on the event source.
+ */
+void
+subscribe_to_events(i3windowManager *i3wm, GError **err)
+{
+    GError *ipc_err = NULL;
+
+    if (i3wm->event_source == I3WM_EVENTS_HELPER)
+    {
+        i3w_shm_watch(i3wm->shm, i3wm->shm_generation, on_shm_changed, i3wm);
         return;
     }
 
+    if (i3wm->event_source == I3WM_EVENTS_THREAD)
+    {
+        gchar *path = connection_socket_path(i3wm);
+        if (!path)
+        {
+            g_set_error(err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "Cannot find the i3 socket");
+            return;
+        }
+
+        i3wm->ingest = i3w_ingest_start(path, on_ingest_record, i3wm, &ipc_err);
+        g_free(path);
+        if (ipc_err != NULL)
+            g_propagate_error(err, ipc_err);
+        return;
+    }
+
+    update_subscriptions(i3wm, err);
+}
+
+/**
+ * wanted_events:
+ * @i3wm: the window manager delegate struct
+ *
+ * Returns: the events the connection needs for the enabled features
+ */
+static i3ipcEvent
+wanted_events(i3windowManager *i3wm)
+{
+    i3ipcEvent events = 0;
+
+    if (i3wm->event_source == I3WM_EVENTS_CONNECTION)
+        events |= I3IPC_EVENT_WORKSPACE | I3IPC_EVENT_MODE | I3IPC_EVENT_OUTPUT;
+    if (i3wm->track_windows || i3wm->watch_window_titles || i3wm->count_windows)
+        events |= I3IPC_EVENT_WINDOW;
+    if (i3wm->watch_bar_config)
+        events |= I3IPC_EVENT_BARCONFIG_UPDATE;
+
+    return events;
+}
+
+/**
+ * update_subscriptions:
+ * @i3wm: the window manager delegate struct
+ * @err: the error object
+ *
+ * Bring the subscriptions of the connection in line with the enabled
+ * features. New events are subscribed to with a single request. i3 cannot
+ * unsubscribe, so dropping events means starting over on a new connection.
+ *
+ * Returns: FALSE on error
+ */
+static gboolean
+update_subscriptions(i3windowManager *i3wm, GError **err)
+{
+    GError *ipc_err = NULL;
+    i3ipcEvent wanted = wanted_events(i3wm);
+
+    if (i3wm->subscribed_events & ~wanted)
+    {
+        i3ipcConnection *connection = i3ipc_connection_new(NULL, &ipc_err);
+        if (ipc_err != NULL)
+        {
+            g_propagate_error(err, ipc_err);
+            return FALSE;
+        }
+
+        g_signal_handlers_disconnect_by_data(i3wm->connection, i3wm);
+        g_object_unref(i3wm->connection);
+        i3wm->connection = connection;
+        i3wm->subscribed_events = 0;
+        connect_signals(i3wm);
+    }
+
+    i3ipcEvent added = wanted & ~i3wm->subscribed_events;
+    if (added)
+    {
+        i3ipcCommandReply *reply = i3ipc_connection_subscribe(i3wm->connection, added, &ipc_err);
+        if (ipc_err != NULL)
+        {
+            g_propagate_error(err, ipc_err);
+            return FALSE;
+        }
+        i3ipc_command_reply_free(reply);
+    }
+
+    i3wm->subscribed_events = wanted;
+    return TRUE;
+}
+
+/**
+ * connect_signals:
+ * @i3wm: the window manager delegate struct
+ *
+ * Connect the event handlers to the connection. Events not subscribed to
+ * never reach them.
+ */
+static void
+connect_signals(i3windowManager *i3wm)
+{
+    g_signal_connect(i3wm->connection, "ipc-shutdown", G_CALLBACK(on_ipc_shutdown_proxy), i3wm);
     g_signal_connect_after(i3wm->connection, "workspace", G_CALLBACK(on_workspace_event), i3wm);
     g_signal_connect_after(i3wm->connection, "mode", G_CALLBACK(on_mode_event), i3wm);
     g_signal_connect_after(i3wm->connection, "output", G_CALLBACK(on_output_event), i3wm);
-
-    i3ipc_command_reply_free(reply);
+    g_signal_connect_after(i3wm->connection, "window", G_CALLBACK(on_window_event), i3wm);
+    g_signal_connect_after(i3wm->connection, "barconfig_update",
+            G_CALLBACK(on_barconfig_update_event), i3wm);
 }
 
 /**
@@ -587,115 +1384,582 @@ invoke_callback(const i3wmCallback callback)
 }
 
 /**
- * on_workspace_event:
+ * init_windows:
+ * @i3wm: the window manager delegate struct
+ *
+ * Build the window tables from the layout tree.
+ */
+static void
+init_windows(i3windowManager *i3wm)
+{
+    clear_windows(i3wm);
+
+    i3wm->windows = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+            NULL, (GDestroyNotify) destroy_window);
+    i3wm->workspace_apps = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, (GDestroyNotify) g_hash_table_unref);
+
+    GError *tree_err = NULL;
+    gint64 start = g_get_monotonic_time();
+    i3ipcCon *tree = i3ipc_connection_get_tree(i3wm->connection, &tree_err);
+    i3w_stats_record(I3W_TIMING_IPC_ROUND_TRIP, start);
+    if (tree_err != NULL)
+    {
+        g_printf("Failed to get the layout tree: %s\n", tree_err->message);
+        g_error_free(tree_err);
+        return;
+    }
+
+    add_con_windows(i3wm, tree, NULL);
+    g_object_unref(tree);
+}
+
+/**
+ * clear_windows:
+ * @i3wm: the window manager delegate struct
+ *
+ * Drop the window tables.
+ */
+static void
+clear_windows(i3windowManager *i3wm)
+{
+    if (i3wm->windows)
+    {
+        g_hash_table_destroy(i3wm->windows);
+        i3wm->windows = NULL;
+    }
+    if (i3wm->workspace_apps)
+    {
+        g_hash_table_destroy(i3wm->workspace_apps);
+        i3wm->workspace_apps = NULL;
+    }
+}
+
+/**
+ * add_window:
+ * @i3wm: the window manager delegate struct
+ * @id: the container id of the window
+ * @app: the window class
+ * @workspace: the name of the workspace the window is on
+ *
+ * Record the window, replacing any previous record of it.
+ *
+ * Returns: TRUE if the application is new on the workspace
+ */
+static gboolean
+add_window(i3windowManager *i3wm, gint64 id, const gchar *app, const gchar *workspace)
+{
+    g_free(remove_window(i3wm, id));
+
+    i3window *window = g_new0(i3window, 1);
+    window->id = id;
+    window->app = g_strdup(app);
+    window->workspace = g_strdup(workspace);
+    g_hash_table_insert(i3wm->windows, &window->id, window);
+
+    GHashTable *apps = g_hash_table_lookup(i3wm->workspace_apps, workspace);
+    if (!apps)
+    {
+        apps = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        g_hash_table_insert(i3wm->workspace_apps, g_strdup(workspace), apps);
+    }
+
+    gint count = GPOINTER_TO_INT(g_hash_table_lookup(apps, app));
+    g_hash_table_insert(apps, g_strdup(app), GINT_TO_POINTER(count + 1));
+
+    return count == 0;
+}
+
+/**
+ * remove_window:
+ * @i3wm: the window manager delegate struct
+ * @id: the container id of the window
+ *
+ * Forget the window.
+ *
+ * Returns: the name of the workspace if its last window of this application
+ * was removed, NULL otherwise. Free with g_free().
+ */
+static gchar *
+remove_window(i3windowManager *i3wm, gint64 id)
+{
+    i3window *window = g_hash_table_lookup(i3wm->windows, &id);
+    if (!window)
+        return NULL;
+
+    gchar *changed = NULL;
+    GHashTable *apps = g_hash_table_lookup(i3wm->workspace_apps, window->workspace);
+    if (apps)
+    {
+        gint count = GPOINTER_TO_INT(g_hash_table_lookup(apps, window->app));
+        if (count > 1)
+        {
+            g_hash_table_insert(apps, g_strdup(window->app), GINT_TO_POINTER(count - 1));
+        }
+        else
+        {
+            g_hash_table_remove(apps, window->app);
+            changed = g_strdup(window->workspace);
+        }
+    }
+
+    g_hash_table_remove(i3wm->windows, &id);
+
+    return changed;
+}
+
+/**
+ * add_con_windows:
+ * @i3wm: the window manager delegate struct
+ * @con: a container of the layout tree
+ * @changed: (nullable): set of the names of the workspaces whose
+ * applications changed
+ *
+ * Record all the windows under the container, or the container itself if it
+ * is a window.
+ */
+static void
+add_con_windows(i3windowManager *i3wm, i3ipcCon *con, GHashTable *changed)
+{
+    GList *leaves = i3ipc_con_leaves(con);
+    if (!leaves)
+        leaves = g_list_prepend(leaves, con);
+
+    GList *litem;
+    for (litem = leaves; litem != NULL; litem = litem->next)
+    {
+        i3ipcCon *leaf = (i3ipcCon *) litem->data;
+        i3ipcCon *workspace = i3ipc_con_workspace(leaf);
+        gulong id = 0;
+        gchar *app = NULL;
+
+        g_object_get(leaf, "id", &id, "window-class", &app, NULL);
+        if (app && workspace)
+        {
+            const gchar *name = i3ipc_con_get_name(workspace);
+            if (add_window(i3wm, id, app, name) && changed)
+                g_hash_table_add(changed, g_strdup(name));
+        }
+        g_free(app);
+    }
+
+    g_list_free(leaves);
+}
+
+/**
+ * window_workspace:
+ * @i3wm: the window manager delegate struct
+ * @id: the container id of the window
+ *
+ * Returns: the name of the workspace of a tracked window, NULL if unknown.
+ * Free with g_free().
+ */
+static gchar *
+window_workspace(i3windowManager *i3wm, gint64 id)
+{
+    if (!i3wm->windows)
+        return NULL;
+
+    i3window *window = g_hash_table_lookup(i3wm->windows, &id);
+    return window ? g_strdup(window->workspace) : NULL;
+}
+
+/**
+ * on_window_event:
  * @conn: the connection with the window manager
  * @e: event data
  * @i3wm: the window manager delegate struct
  *
- * The workspace event callback.
+ * The window event callback. Updates the window tables and reports the
+ * changes of the window titles, with the workspace when the window is
+ * tracked. Opening, closing or moving a window queues a refresh of the
+ * window counts.
  */
-void
-on_workspace_event(i3ipcConnection *conn, i3ipcWorkspaceEvent *e, gpointer i3wm)
+static void
+on_window_event(i3ipcConnection *conn, i3ipcWindowEvent *e, gpointer i3w)
 {
-    if (strncmp(e->change, "focus", 5) == 0) on_focus_workspace((i3windowManager *) i3wm, e->current, e->old);
-    else if (strncmp(e->change, "init", 5) == 0) on_init_workspace((i3windowManager *) i3wm);
-    else if (strncmp(e->change, "empty", 5) == 0) on_empty_workspace((i3windowManager *) i3wm);
-    else if (strncmp(e->change, "urgent", 6) == 0) on_urgent_workspace((i3windowManager *) i3wm);
-    else if (strncmp(e->change, "rename", 6) == 0) on_rename_workspace((i3windowManager *) i3wm);
-    else if (strncmp(e->change, "move", 4) == 0) on_move_workspace((i3windowManager *) i3wm);
-    else g_printf("Unknown event: %s\n", e->change);
+    i3windowManager *i3wm = (i3windowManager *) i3w;
+    gboolean titles_changed = FALSE;
+    gchar *workspace = NULL;
+    gulong id = 0;
+
+    i3w_stats_add(I3W_STAT_WINDOW_EVENTS, 1);
+
+    if (!e->container)
+        return;
+
+    if (i3wm->count_windows && (g_strcmp0(e->change, "new") == 0 ||
+            g_strcmp0(e->change, "close") == 0 || g_strcmp0(e->change, "move") == 0))
+        enqueue_event(i3wm, I3WM_EVENT_INIT, NULL);
+
+    if (i3wm->watch_window_titles)
+    {
+        titles_changed = g_strcmp0(e->change, "title") == 0 ||
+            g_strcmp0(e->change, "new") == 0 ||
+            g_strcmp0(e->change, "close") == 0 ||
+            g_strcmp0(e->change, "move") == 0;
+
+        // a moved window changes two workspaces, report it as unknown
+        g_object_get(e->container, "id", &id, NULL);
+        if (titles_changed && g_strcmp0(e->change, "move") != 0)
+            workspace = window_workspace(i3wm, id);
+    }
+
+    track_window_event(i3wm, e);
+
+    if (titles_changed && i3wm->on_window_titles_changed.function)
+    {
+        if (!workspace && g_strcmp0(e->change, "new") == 0)
+            workspace = window_workspace(i3wm, id);
+        i3wm->on_window_titles_changed.function(workspace,
+                i3wm->on_window_titles_changed.data);
+    }
+
+    g_free(workspace);
 }
 
 /**
- * on_focus_workspace:
+ * track_window_event:
  * @i3wm: the window manager delegate struct
- * @current: the currently focused workspace
- * @old: the previously focused workspace
+ * @e: event data
  *
- * Focus workspace event handler.
+ * Closed windows are removed from the tables directly, new and moved windows
+ * are located in the layout tree. Only the workspaces whose set of
+ * applications changed are reported.
  */
-void
-on_focus_workspace(i3windowManager *i3wm, i3ipcCon *current, i3ipcCon *old)
+static void
+track_window_event(i3windowManager *i3wm, i3ipcWindowEvent *e)
 {
-  GError *tmp_err = NULL;
-  init_workspaces(i3wm, &tmp_err);
-  invoke_callback(i3wm->on_workspace_focused);
+    gboolean is_close = g_strcmp0(e->change, "close") == 0;
+
+    if (!i3wm->track_windows)
+        return;
+    if (!is_close && g_strcmp0(e->change, "new") != 0 && g_strcmp0(e->change, "move") != 0)
+        return;
+
+    GHashTable *changed = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    gulong id = 0;
+    g_object_get(e->container, "id", &id, NULL);
+
+    if (is_close)
+    {
+        gchar *workspace = remove_window(i3wm, id);
+        if (workspace)
+            g_hash_table_add(changed, workspace);
+    }
+    else
+    {
+        GError *tree_err = NULL;
+        gint64 start = g_get_monotonic_time();
+        i3ipcCon *tree = i3ipc_connection_get_tree(i3wm->connection, &tree_err);
+        i3w_stats_record(I3W_TIMING_IPC_ROUND_TRIP, start);
+        if (tree_err != NULL)
+        {
+            g_printf("Failed to get the layout tree: %s\n", tree_err->message);
+            g_error_free(tree_err);
+            g_hash_table_destroy(changed);
+            return;
+        }
+
+        i3ipcCon *con = i3ipc_con_find_by_id(tree, id);
+        if (con)
+        {
+            // a moved window may have left the last of its kind behind
+            GList *leaves = i3ipc_con_leaves(con);
+            if (!leaves)
+                leaves = g_list_prepend(leaves, con);
+
+            GList *litem;
+            for (litem = leaves; litem != NULL; litem = litem->next)
+            {
+                gulong leaf_id = 0;
+                g_object_get(litem->data, "id", &leaf_id, NULL);
+                gchar *workspace = remove_window(i3wm, leaf_id);
+                if (workspace)
+                    g_hash_table_add(changed, workspace);
+            }
+            g_list_free(leaves);
+
+            add_con_windows(i3wm, con, changed);
+        }
+        g_object_unref(tree);
+    }
+
+    if (i3wm->on_workspace_windows_changed.function)
+    {
+        GHashTableIter iter;
+        gpointer workspace;
+
+        g_hash_table_iter_init(&iter, changed);
+        while (g_hash_table_iter_next(&iter, &workspace, NULL))
+            i3wm->on_workspace_windows_changed.function((const gchar *) workspace,
+                    i3wm->on_workspace_windows_changed.data);
+    }
+
+    g_hash_table_destroy(changed);
 }
 
 /**
- * on_init_workspace:
- * @i3wm - the window manager delegate struct
+ * on_workspace_event:
+ * @conn: the connection with the window manager
+ * @e: event data
+ * @i3wm: the window manager delegate struct
  *
- * Init workspace event handler
+ * The workspace event callback. The event is only queued, see
+ * process_event_queue.
  */
 void
-on_init_workspace(i3windowManager *i3wm)
+on_workspace_event(i3ipcConnection *conn, i3ipcWorkspaceEvent *e, gpointer i3wm)
 {
-  GError *tmp_err = NULL;
-  init_workspaces(i3wm, &tmp_err);
-  invoke_callback(i3wm->on_workspace_created);
+    I3W_PROBE2(workspace_event, e->change, ((i3windowManager *) i3wm)->workspace_count);
+    i3w_stats_add(I3W_STAT_WORKSPACE_EVENTS, 1);
+
+    gint type = workspace_event_type(e->change);
+
+    if (type < 0)
+    {
+        g_printf("Unknown event: %s\n", e->change);
+        return;
+    }
+
+    enqueue_event((i3windowManager *) i3wm, type,
+            e->current ? i3ipc_con_get_name(e->current) : NULL);
 }
 
 /**
- * on_empty_workspace:
- * @i3wm - the window manager delegate struct
+ * workspace_event_type:
+ * @change: the change field of a workspace event
  *
- * Empty workspace event handler
+ * Returns: the i3wmEventType of the change, -1 if unknown
  */
-void
-on_empty_workspace(i3windowManager *i3wm)
+static gint
+workspace_event_type(const gchar *change)
 {
-  GError *tmp_err = NULL;
-  init_workspaces(i3wm, &tmp_err);
-  invoke_callback(i3wm->on_workspace_destroyed);
+    gint type;
+
+    for (type = 0; type < I3WM_EVENT_COUNT; type++)
+    {
+        if (type != I3WM_EVENT_OUTPUT && g_strcmp0(change, event_names[type]) == 0)
+            return type;
+    }
+
+    return -1;
 }
 
 /**
- * on_urgent_workspace:
+ * enqueue_event:
  * @i3wm: the window manager delegate struct
+ * @type: the event type
+ * @workspace: (nullable): the name of the workspace the event is about
  *
- * Urgent workspace event handler.
- * This can mean two thigs: either a workspace became urgent or it was urgent and
- * now it isn't.
+ * Queue the event for the next batch. An event of the same type for the same
+ * workspace supersedes the queued one, a rename supersedes any queued rename
+ * since the buttons are rebuilt the same way whichever workspace it was. When
+ * the queue is full it is dropped altogether and the next batch does a single
+ * full resync instead.
  */
-void
-on_urgent_workspace(i3windowManager *i3wm)
+static void
+enqueue_event(i3windowManager *i3wm, i3wmEventType type, const gchar *workspace)
 {
-  GError *tmp_err = NULL;
-  init_workspaces(i3wm, &tmp_err);
-  invoke_callback(i3wm->on_workspace_urgent);
+    i3wmQueueStats *stats = &i3wm->queue_stats;
+    guint i;
+
+    stats->enqueued[type]++;
+
+    if (!i3wm->event_queue_idle)
+        i3wm->event_queue_idle = g_idle_add(process_event_queue, i3wm);
+
+    if (i3wm->event_queue_overflow)
+        return;
+
+    for (i = 0; i < i3wm->event_queue_len; i++)
+    {
+        i3wmEvent *queued = &i3wm->event_queue[i];
+        if (queued->type == type &&
+                (type == I3WM_EVENT_RENAME || g_strcmp0(queued->workspace, workspace) == 0))
+        {
+            stats->collapsed[type]++;
+            return;
+        }
+    }
+
+    if (i3wm->event_queue_len == I3WM_EVENT_QUEUE_SIZE)
+    {
+        enqueue_resync(i3wm);
+        return;
+    }
+
+    i3wmEvent *event = &i3wm->event_queue[i3wm->event_queue_len++];
+    event->type = type;
+    event->workspace = g_strdup(workspace);
+
+    stats->depth[type]++;
+    stats->max_depth = MAX(stats->max_depth, i3wm->event_queue_len);
 }
 
 /**
- * on_rename_workspace:
+ * enqueue_resync:
  * @i3wm: the window manager delegate struct
  *
- * Renamed workspace event handler.
+ * Replace the queued events with a full resync.
  */
-void
-on_rename_workspace(i3windowManager *i3wm)
+static void
+enqueue_resync(i3windowManager *i3wm)
 {
-  GError *tmp_err = NULL;
-  init_workspaces(i3wm, &tmp_err);
-  // Since created already removes/adds all the worskpaces,
-  // we don't need to also call the "destroyed" callback
-  invoke_callback(i3wm->on_workspace_created);
+    i3wm->queue_stats.overflows++;
+    clear_event_queue(i3wm);
+    i3wm->event_queue_overflow = TRUE;
+
+    if (!i3wm->event_queue_idle)
+        i3wm->event_queue_idle = g_idle_add(process_event_queue, i3wm);
 }
 
 /**
- * on_move_workspace:
+ * clear_event_queue:
  * @i3wm: the window manager delegate struct
  *
- * Moved workspace event handler.
+ * Drop all the queued events.
  */
-void
-on_move_workspace(i3windowManager *i3wm)
+static void
+clear_event_queue(i3windowManager *i3wm)
 {
-  GError *tmp_err = NULL;
-  init_workspaces(i3wm, &tmp_err);
-  // Since created already removes/adds all the worskpaces,
-  // we don't need to also call the "destroyed" callback
-  invoke_callback(i3wm->on_workspace_created);
+    guint i;
+
+    for (i = 0; i < i3wm->event_queue_len; i++)
+        g_free(i3wm->event_queue[i].workspace);
+
+    i3wm->event_queue_len = 0;
+    memset(i3wm->queue_stats.depth, 0, sizeof(i3wm->queue_stats.depth));
+}
+
+/**
+ * format_queue_stats:
+ * @text: the diagnostics being built
+ * @i3w: the window manager delegate struct
+ *
+ * Append the counters of the event queue, per event type then in total.
+ */
+static void
+format_queue_stats(GString *text, gpointer i3w)
+{
+    const i3wmQueueStats *stats = i3wm_get_queue_stats((i3windowManager *) i3w);
+    guint i;
+
+    g_string_append_printf(text, "\n%-18s %10s %10s %8s\n",
+            "event queue", "enqueued", "collapsed", "depth");
+
+    for (i = 0; i < I3WM_EVENT_COUNT; i++)
+    {
+        g_string_append_printf(text, "%-18s %10u %10u %8u\n",
+                i3wm_event_type_name(i), stats->enqueued[i], stats->collapsed[i],
+                stats->depth[i]);
+    }
+
+    g_string_append_printf(text, "%-18s %10u\n", "max depth", stats->max_depth);
+    g_string_append_printf(text, "%-18s %10u\n", "overflows", stats->overflows);
+    g_string_append_printf(text, "%-18s %10u\n", "batches", stats->batches);
+}
+
+/**
+ * process_event_queue:
+ * @i3w: the window manager delegate struct
+ *
+ * Handle all the queued events at once: the workspaces are refreshed a single
+ * time, then the callbacks run in the order of their first event, each
+ * distinct callback at most once. After an overflow this is a full resync. Renames rebuild the
+ * window tables once per batch.
+ *
+ * Returns: G_SOURCE_REMOVE
+ */
+static gboolean
+process_event_queue(gpointer i3w)
+{
+    i3windowManager *i3wm = (i3windowManager *) i3w;
+    i3wmCallback *invoked[I3WM_EVENT_COUNT];
+    guint n_invoked = 0;
+    guint i, j;
+
+    i3wm->event_queue_idle = 0;
+    i3wm->queue_stats.batches++;
+
+    // the window tables are keyed by workspace name and i3 does not tell
+    // the old name of a renamed workspace, so they are built again
+    if (i3wm->track_windows &&
+            (i3wm->event_queue_overflow || i3wm->queue_stats.depth[I3WM_EVENT_RENAME]))
+        init_windows(i3wm);
+
+    GError *tmp_err = NULL;
+    gboolean failed = FALSE;
+    gboolean changed = init_workspaces(i3wm, &tmp_err);
+    if (tmp_err != NULL)
+    {
+        g_printf("Failed to refresh the workspaces: %s\n", tmp_err->message);
+        g_error_free(tmp_err);
+        i3w_stats_add(I3W_STAT_REFRESH_FAILURES, 1);
+        failed = TRUE;
+    }
+
+    /* nothing the buttons show changed, the outputs may have though */
+    if (!failed && !changed && !i3wm->event_queue_overflow &&
+            !i3wm->queue_stats.depth[I3WM_EVENT_OUTPUT])
+    {
+        clear_event_queue(i3wm);
+        i3w_stats_add(I3W_STAT_SUPPRESSED_REFRESHES, 1);
+        return G_SOURCE_REMOVE;
+    }
+
+    if (i3wm->event_queue_overflow)
+    {
+        i3wm->event_queue_overflow = FALSE;
+        clear_event_queue(i3wm);
+        i3w_stats_add(I3W_STAT_RESYNCS, 1);
+        invoke_callback(i3wm->on_workspace_created);
+        return G_SOURCE_REMOVE;
+    }
+
+    for (i = 0; i < i3wm->event_queue_len; i++)
+    {
+        i3wmCallback *callback = event_callback(i3wm, i3wm->event_queue[i].type);
+        gboolean seen = FALSE;
+        for (j = 0; j < n_invoked; j++)
+        {
+            if (invoked[j]->function == callback->function &&
+                invoked[j]->data == callback->data)
+                seen = TRUE;
+        }
+
+        if (!seen && n_invoked < I3WM_EVENT_COUNT)
+            invoked[n_invoked++] = callback;
+    }
+
+    clear_event_queue(i3wm);
+
+    for (i = 0; i < n_invoked; i++)
+        invoke_callback(*invoked[i]);
+
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * event_callback:
+ * @i3wm: the window manager delegate struct
+ * @type: the event type
+ *
+ * Since created already removes/adds all the worskpaces, it also serves
+ * the rename, move and output events.
+ *
+ * Returns: the callback of the event type
+ */
+static i3wmCallback *
+event_callback(i3windowManager *i3wm, i3wmEventType type)
+{
+    switch (type)
+    {
+        case I3WM_EVENT_FOCUS: return &i3wm->on_workspace_focused;
+        case I3WM_EVENT_EMPTY: return &i3wm->on_workspace_destroyed;
+        case I3WM_EVENT_URGENT: return &i3wm->on_workspace_urgent;
+        default: return &i3wm->on_workspace_created;
+    }
 }
 
 /**
@@ -709,6 +1973,8 @@ on_move_workspace(i3windowManager *i3wm)
 void
 on_mode_event(i3ipcConnection *conn, i3ipcGenericEvent *e, gpointer i3w) {
     i3windowManager *i3wm = (i3windowManager *) i3w;
+    I3W_PROBE2(mode_event, e->change, i3wm->workspace_count);
+    i3w_stats_add(I3W_STAT_MODE_EVENTS, 1);
     i3wm->on_mode_changed.function(e->change, i3wm->on_mode_changed.data);
 }
 
@@ -723,9 +1989,214 @@ on_mode_event(i3ipcConnection *conn, i3ipcGenericEvent *e, gpointer i3w) {
 void 
 on_output_event(i3ipcConnection *conn, i3ipcGenericEvent *e, gpointer i3w) {
     i3windowManager *i3wm = (i3windowManager *) i3w;
-    GError *tmp_err = NULL;
-    init_workspaces(i3wm, &tmp_err);
-    invoke_callback(i3wm->on_workspace_created);
+    I3W_PROBE2(output_event, e->change, i3wm->workspace_count);
+    i3w_stats_add(I3W_STAT_OUTPUT_EVENTS, 1);
+    enqueue_event(i3wm, I3WM_EVENT_OUTPUT, NULL);
+}
+
+/**
+ * fetch_bar_colors:
+ * @i3wm: the window manager delegate struct
+ * @err: the error object
+ *
+ * Read the colors of the first bar with GET_BAR_CONFIG. Without any bar
+ * configured there are no colors.
+ */
+static void
+fetch_bar_colors(i3windowManager *i3wm, GError **err)
+{
+    GError *get_err = NULL;
+
+    if (i3wm->bar_colors)
+    {
+        g_hash_table_destroy(i3wm->bar_colors);
+        i3wm->bar_colors = NULL;
+    }
+
+    if (!i3wm->bar_id)
+    {
+        GSList *ids = i3ipc_connection_get_bar_config_list(i3wm->connection, &get_err);
+        if (get_err != NULL)
+        {
+            g_propagate_error(err, get_err);
+            return;
+        }
+
+        i3wm->bar_id = ids ? g_strdup((const gchar *) ids->data) : NULL;
+        g_slist_free_full(ids, g_free);
+
+        if (!i3wm->bar_id)
+            return;
+    }
+
+    gint64 start = g_get_monotonic_time();
+    i3ipcBarConfigReply *reply = i3ipc_connection_get_bar_config(i3wm->connection,
+            i3wm->bar_id, &get_err);
+    i3w_stats_record(I3W_TIMING_IPC_ROUND_TRIP, start);
+    if (get_err != NULL)
+    {
+        g_propagate_error(err, get_err);
+        return;
+    }
+
+    i3wm->bar_colors = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    if (reply->colors)
+    {
+        GHashTableIter iter;
+        gpointer name, color;
+
+        g_hash_table_iter_init(&iter, reply->colors);
+        while (g_hash_table_iter_next(&iter, &name, &color))
+            g_hash_table_insert(i3wm->bar_colors, g_strdup(name), g_strdup(color));
+    }
+
+    i3ipc_bar_config_reply_free(reply);
+}
+
+/**
+ * on_barconfig_update_event:
+ * @conn: the connection
+ * @e: the event
+ * @i3w: the window manager delegate struct
+ *
+ * The bar configuration changed, i3 was reloaded. The colors of our bar are
+ * read again, the event itself does not carry them.
+ */
+static void
+on_barconfig_update_event(i3ipcConnection *conn, i3ipcBarconfigUpdateEvent *e, gpointer i3w)
+{
+    i3windowManager *i3wm = (i3windowManager *) i3w;
+    GError *err = NULL;
+
+    if (!i3wm->watch_bar_config)
+        return;
+    if (i3wm->bar_id && e->id && g_strcmp0(i3wm->bar_id, e->id) != 0)
+        return;
+
+    fetch_bar_colors(i3wm, &err);
+    if (err != NULL)
+    {
+        g_printf("Failed to get the bar configuration: %s\n", err->message);
+        g_error_free(err);
+    }
+
+    invoke_callback(i3wm->on_bar_config_changed);
+}
+
+/**
+ * on_ingest_record:
+ * @record: the decoded event, NULL if events were lost
+ * @i3w: the window manager delegate struct
+ *
+ * Feed the records of the ingestion thread into the event queue, the same
+ * way as the events of the i3ipc-glib connection.
+ */
+static void
+on_ingest_record(const i3wIngestRecord *record, gpointer i3w)
+{
+    i3windowManager *i3wm = (i3windowManager *) i3w;
+    gint type;
+
+    if (!record)
+    {
+        enqueue_resync(i3wm);
+        return;
+    }
+
+    switch (record->kind)
+    {
+        case I3W_INGEST_WORKSPACE:
+            I3W_PROBE2(workspace_event, record->change, i3wm->workspace_count);
+            i3w_stats_add(I3W_STAT_WORKSPACE_EVENTS, 1);
+            type = workspace_event_type(record->change);
+            if (type < 0)
+                g_printf("Unknown event: %s\n", record->change);
+            else
+                enqueue_event(i3wm, type, record->name[0] ? record->name : NULL);
+            break;
+        case I3W_INGEST_OUTPUT:
+            I3W_PROBE2(output_event, "unspecified", i3wm->workspace_count);
+            i3w_stats_add(I3W_STAT_OUTPUT_EVENTS, 1);
+            enqueue_event(i3wm, I3WM_EVENT_OUTPUT, NULL);
+            break;
+        case I3W_INGEST_MODE:
+            I3W_PROBE2(mode_event, record->name, i3wm->workspace_count);
+            i3w_stats_add(I3W_STAT_MODE_EVENTS, 1);
+            if (i3wm->on_mode_changed.function)
+                i3wm->on_mode_changed.function((gchar *) record->name, i3wm->on_mode_changed.data);
+            break;
+        case I3W_INGEST_SHUTDOWN:
+            on_ipc_shutdown_proxy(i3wm->connection, i3wm);
+            break;
+    }
+}
+
+/**
+ * on_shm_changed:
+ * @i3w: the window manager delegate struct
+ *
+ * Read the new model of the workspace helper and queue the events which
+ * explain the changes to the previous one.
+ */
+static void
+on_shm_changed(gpointer i3w)
+{
+    i3windowManager *i3wm = (i3windowManager *) i3w;
+    i3wShmModel *old = i3wm->shm_model;
+    i3wShmModel *model = g_new(i3wShmModel, 1);
+    guint i;
+
+    if (!i3w_shm_read(i3wm->shm, model, NULL))
+    {
+        g_free(model);
+        on_ipc_shutdown_proxy(i3wm->connection, i3wm);
+        return;
+    }
+
+    i3wm->shm_model = model;
+
+    if (strcmp(old->mode, model->mode) != 0)
+    {
+        I3W_PROBE2(mode_event, model->mode, i3wm->workspace_count);
+        i3w_stats_add(I3W_STAT_MODE_EVENTS, 1);
+        if (i3wm->on_mode_changed.function)
+            i3wm->on_mode_changed.function(model->mode, i3wm->on_mode_changed.data);
+    }
+
+    if (old->n_outputs != model->n_outputs ||
+        memcmp(old->outputs, model->outputs, sizeof(model->outputs[0]) * model->n_outputs) != 0)
+    {
+        I3W_PROBE2(output_event, "unspecified", i3wm->workspace_count);
+        i3w_stats_add(I3W_STAT_OUTPUT_EVENTS, 1);
+        enqueue_event(i3wm, I3WM_EVENT_OUTPUT, NULL);
+    }
+
+    for (i = 0; i < MAX(old->n_workspaces, model->n_workspaces); i++)
+    {
+        const i3wShmWorkspace *before = &old->workspaces[i];
+        const i3wShmWorkspace *after = &model->workspaces[i];
+        const gchar *name = i3w_shm_model_workspace_name(model, after);
+        guint32 changed = before->flags ^ after->flags;
+
+        // i3 lists the workspaces in the order of the tree
+        if (i >= old->n_workspaces || i >= model->n_workspaces ||
+            strcmp(i3w_shm_model_workspace_name(old, before), name) != 0)
+        {
+            I3W_PROBE2(workspace_event, "init", i3wm->workspace_count);
+            i3w_stats_add(I3W_STAT_WORKSPACE_EVENTS, 1);
+            enqueue_event(i3wm, I3WM_EVENT_INIT, NULL);
+            break;
+        }
+
+        if (strcmp(before->output, after->output) != 0)
+            enqueue_event(i3wm, I3WM_EVENT_MOVE, name);
+        if (changed & (I3W_SHM_FOCUSED | I3W_SHM_VISIBLE))
+            enqueue_event(i3wm, I3WM_EVENT_FOCUS, name);
+        if (changed & I3W_SHM_URGENT)
+            enqueue_event(i3wm, I3WM_EVENT_URGENT, name);
+    }
+
+    g_free(old);
 }
 
 /**
@@ -21,6 +21,10 @@
 
 #include <i3ipc-glib/i3ipc-glib.h>
 
+#include "i3w-ipc-ingest.h"
+#include "i3w-shm.h"
+#include "i3w-latency.h"
+
 typedef struct _i3workspace
 {
     gint num;
@@ -29,12 +33,30 @@ typedef struct _i3workspace
     gboolean urgent;
     gboolean visible;
     gchar *output;
+    gint windows;
+    // generation of the snapshot the workspace got into this state
+    guint64 generation;
 } i3workspace;
 
+/*
+ * The workspaces published by the delegate. A snapshot is never modified,
+ * every model update publishes a new one with a higher generation. A
+ * workspace keeps its generation as long as its state does not change, so
+ * comparing generations is enough to skip the unchanged workspaces.
+ */
+typedef struct _i3wm_workspaces
+{
+    gint ref_count;
+    guint64 generation;
+    // i3workspace *, sorted by name
+    GSList *wlist;
+} i3wmWorkspaces;
+
 typedef void (*i3wmWorkspaceCallback) (gpointer data);
 typedef void (*i3wmModeCallback_fun) (gchar *mode, gpointer data);
 typedef void (*i3wmOutputCallback_fun) (gchar *mode, gpointer data);
 typedef void (*i3wmIpcShutdownCallback) (gpointer data);
+typedef void (*i3wmWindowsCallback_fun) (const gchar *workspace, gpointer data);
 
 typedef struct _i3wm_callback
 {
@@ -54,10 +76,100 @@ typedef struct _i3wm_output_callback
     gpointer data;
 } i3wmOutputCallback;
 
+/*
+ * Workspace and output events are queued and handled in batches, see
+ * on_workspace_event in i3wm-delegate.c.
+ */
+typedef enum
+{
+    I3WM_EVENT_FOCUS,
+    I3WM_EVENT_INIT,
+    I3WM_EVENT_EMPTY,
+    I3WM_EVENT_MOVE,
+    I3WM_EVENT_OUTPUT,
+    I3WM_EVENT_URGENT,
+    I3WM_EVENT_RENAME,
+    I3WM_EVENT_COUNT
+} i3wmEventType;
+
+#define I3WM_EVENT_QUEUE_SIZE 32
+
+/*
+ * Where the workspace, mode and output events come from: the i3ipc-glib
+ * connection, the ingestion thread or the workspace helper shared by all
+ * the panels.
+ */
+typedef enum
+{
+    I3WM_EVENTS_CONNECTION,
+    I3WM_EVENTS_THREAD,
+    I3WM_EVENTS_HELPER
+} i3wmEventSource;
+
+typedef struct _i3wm_event
+{
+    i3wmEventType type;
+    gchar *workspace;
+} i3wmEvent;
+
+typedef struct _i3wm_queue_stats
+{
+    // per event type
+    guint enqueued[I3WM_EVENT_COUNT];
+    guint collapsed[I3WM_EVENT_COUNT];
+    guint depth[I3WM_EVENT_COUNT];
+
+    guint max_depth;
+    guint overflows;
+    guint batches;
+} i3wmQueueStats;
+
+typedef struct _i3wm_windows_callback
+{
+    i3wmWindowsCallback_fun function;
+    gpointer data;
+} i3wmWindowsCallback;
+
 typedef struct _i3windowManager
 {
     i3ipcConnection *connection;
-    GSList *wlist;
+    // the events the connection is subscribed to, see update_subscriptions
+    i3ipcEvent subscribed_events;
+    i3wmEventSource event_source;
+    // decodes the workspace, mode and output events when not NULL
+    i3wIngest *ingest;
+    // the last workspaces queried by the ingestion thread
+    i3wShmModel *ingest_model;
+    // the region of the workspace helper and the last model read from it
+    i3wShm *shm;
+    i3wShmModel *shm_model;
+    // generation of the model read when the helper was opened
+    gint shm_generation;
+    // the current snapshot, never NULL after construction
+    i3wmWorkspaces *workspaces;
+    guint workspace_count;
+    gboolean count_windows;
+
+    i3wmEvent event_queue[I3WM_EVENT_QUEUE_SIZE];
+    guint event_queue_len;
+    gboolean event_queue_overflow;
+    guint event_queue_idle;
+    i3wmQueueStats queue_stats;
+
+    // window tracking: window id => i3window * and
+    // workspace name => (window class => number of windows)
+    gboolean track_windows;
+    GHashTable *windows;
+    GHashTable *workspace_apps;
+    // report title, new, close and move window events
+    gboolean watch_window_titles;
+    // tick round trip probe, NULL when disabled
+    i3wLatency *latency;
+    guint latency_probe_interval;
+    // colors of the first bar, name => "#rrggbb[aa]", NULL unless watched
+    gboolean watch_bar_config;
+    gchar *bar_id;
+    GHashTable *bar_colors;
 
     i3wmCallback on_workspace_created;
     i3wmCallback on_workspace_destroyed;
@@ -67,6 +179,9 @@ typedef struct _i3windowManager
     i3wmCallback on_workspace_renamed;
     i3wmModeCallback on_mode_changed;
     i3wmOutputCallback on_output_changed;
+    i3wmWindowsCallback on_workspace_windows_changed;
+    i3wmWindowsCallback on_window_titles_changed;
+    i3wmCallback on_bar_config_changed;
     i3wmIpcShutdownCallback on_ipc_shutdown;
     gpointer on_ipc_shutdown_data;
 }
@@ -74,7 +189,7 @@ i3windowManager;
 
 
 i3windowManager *
-i3wm_construct(GError **err);
+i3wm_construct(i3wmEventSource event_source, GError **err);
 
 void
 i3wm_destruct(i3windowManager *i3wm);
@@ -82,9 +197,42 @@ i3wm_destruct(i3windowManager *i3wm);
 GSList *
 i3wm_get_workspaces(i3windowManager *i3wm);
 
+i3wmWorkspaces *
+i3wm_ref_workspaces(i3windowManager *i3wm);
+
+void
+i3wm_unref_workspaces(i3wmWorkspaces *workspaces);
+
 gint
 i3wm_workspace_cmp(const i3workspace *a, const i3workspace *b);
 
+void
+i3wm_set_count_windows(i3windowManager *i3wm, gboolean count_windows, GError **err);
+
+const i3wmQueueStats *
+i3wm_get_queue_stats(i3windowManager *i3wm);
+
+const gchar *
+i3wm_event_type_name(i3wmEventType type);
+
+void
+i3wm_set_track_windows(i3windowManager *i3wm, gboolean track_windows, GError **err);
+
+void
+i3wm_set_watch_window_titles(i3windowManager *i3wm, gboolean watch, GError **err);
+
+void
+i3wm_set_latency_probe_interval(i3windowManager *i3wm, guint interval, GError **err);
+
+GList *
+i3wm_get_workspace_apps(i3windowManager *i3wm, const gchar *workspace);
+
+void
+i3wm_set_watch_bar_config(i3windowManager *i3wm, gboolean watch, GError **err);
+
+GHashTable *
+i3wm_get_bar_colors(i3windowManager *i3wm);
+
 void
 i3wm_set_on_workspace_created(i3windowManager *i3wm, i3wmWorkspaceCallback callback, gpointer data);
 
@@ -109,10 +257,19 @@ i3wm_set_on_mode_changed(i3windowManager *i3wm, i3wmModeCallback_fun callback, g
 void
 i3wm_set_on_output_changed(i3windowManager *i3wm, i3wmOutputCallback_fun callback, gpointer data);
 
+void
+i3wm_set_on_workspace_windows_changed(i3windowManager *i3wm, i3wmWindowsCallback_fun callback, gpointer data);
+
+void
+i3wm_set_on_window_titles_changed(i3windowManager *i3wm, i3wmWindowsCallback_fun callback, gpointer data);
+
+void
+i3wm_set_on_bar_config_changed(i3windowManager *i3wm, i3wmWorkspaceCallback callback, gpointer data);
+
 void
 i3wm_set_on_ipc_shutdown(i3windowManager *i3wm, i3wmIpcShutdownCallback callback, gpointer data);
 
 void
-i3wm_goto_workspace(i3windowManager *i3wm, i3workspace *workspace, GError **err);
+i3wm_goto_workspace(i3windowManager *i3wm, const gchar *workspace, GError **err);
 
 #endif /* !__I3W_DELEGATE_H__ */
@@ -0,0 +1,457 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <glib-unix.h>
+#include <glib/gstdio.h>
+#include <gmodule.h>
+#include <libxfce4panel/libxfce4panel.h>
+
+#include "i3w-test.h"
+
+#define PLUGIN_NAME "i3-workspaces"
+#define PLUGIN_ID 1
+#define MOCK_START_TIMEOUT_US (5 * G_USEC_PER_SEC)
+
+typedef XfcePanelPlugin *(*ConstructFunc)(const gchar *name, gint unique_id,
+        const gchar *display_name, const gchar *comment, gchar **arguments,
+        GdkScreen *screen);
+
+struct _i3w_test_mock
+{
+    GPid pid;
+    gint input;
+    gint output;
+    guint output_watch;
+    gboolean synced;
+};
+
+static gchar *test_dir;
+static guint wakeups;
+static gboolean failed;
+
+/*
+ * Prototypes
+ */
+static gint
+counting_poll(GPollFD *fds, guint nfds, gint timeout);
+static gboolean
+on_mock_output(gint fd, GIOCondition condition, gpointer data);
+static gboolean
+quit_loop(gpointer data);
+static void
+remove_dir(const gchar *path);
+
+/*
+ * Implementations of public functions
+ */
+
+/**
+ * i3w_test_init:
+ * @argc: the argument count
+ * @argv: the arguments
+ * @rc: (nullable): the configuration of the plugin, in the rc file format
+ *
+ * Point the configuration, the cache and the i3 socket into a fresh
+ * directory, write the configuration and set up GTK with the wakeup
+ * counting poll.
+ */
+void
+i3w_test_init(int *argc, char ***argv, const gchar *rc)
+{
+    GError *err = NULL;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    test_dir = g_dir_make_tmp("i3w-test-XXXXXX", &err);
+    if (!test_dir)
+        g_error("Cannot create the test directory: %s", err->message);
+
+    gchar *config = g_build_filename(test_dir, "config", NULL);
+    gchar *cache = g_build_filename(test_dir, "cache", NULL);
+    gchar *socket = g_build_filename(test_dir, "ipc.sock", NULL);
+    g_setenv("XDG_CONFIG_HOME", config, TRUE);
+    g_setenv("XDG_CACHE_HOME", cache, TRUE);
+    g_setenv("I3SOCK", socket, TRUE);
+
+    // nothing else in the process should wake up
+    g_setenv("GSETTINGS_BACKEND", "memory", TRUE);
+    g_setenv("NO_AT_BRIDGE", "1", TRUE);
+
+    if (rc)
+    {
+        gchar *dir = g_build_filename(config, "xfce4", "panel", NULL);
+        gchar *file = g_strdup_printf("%s/%s-%d.rc", dir, PLUGIN_NAME, PLUGIN_ID);
+        g_mkdir_with_parents(dir, 0700);
+        if (!g_file_set_contents(file, rc, -1, &err))
+            g_error("Cannot write the configuration: %s", err->message);
+        g_free(file);
+        g_free(dir);
+    }
+
+    g_free(config);
+    g_free(cache);
+    g_free(socket);
+
+    gtk_init(argc, argv);
+    g_main_context_set_poll_func(NULL, counting_poll);
+}
+
+/**
+ * i3w_test_mock_start:
+ *
+ * Start mock-i3 on the socket of the test and wait for it to listen.
+ *
+ * Returns: the mock, stop with i3w_test_mock_stop()
+ */
+i3wTestMock *
+i3w_test_mock_start(void)
+{
+    GError *err = NULL;
+    const gchar *socket = g_getenv("I3SOCK");
+    gchar *argv[] = { (gchar *) g_getenv("I3W_MOCK_I3"), (gchar *) socket, NULL };
+
+    if (!argv[0])
+        g_error("I3W_MOCK_I3 is not set");
+
+    g_unlink(socket);
+
+    i3wTestMock *mock = g_new0(i3wTestMock, 1);
+    if (!g_spawn_async_with_pipes(NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL,
+                &mock->pid, &mock->input, &mock->output, NULL, &err))
+        g_error("Cannot start mock-i3: %s", err->message);
+
+    mock->output_watch = g_unix_fd_add(mock->output, G_IO_IN | G_IO_HUP, on_mock_output, mock);
+
+    gint64 deadline = g_get_monotonic_time() + MOCK_START_TIMEOUT_US;
+    while (!g_file_test(socket, G_FILE_TEST_EXISTS))
+    {
+        if (g_get_monotonic_time() > deadline)
+            g_error("mock-i3 did not start listening");
+        g_usleep(10000);
+    }
+
+    return mock;
+}
+
+/**
+ * i3w_test_mock_send:
+ * @mock: the mock
+ * @format: the command, see mock-i3.c
+ *
+ * Send a command to the mock. Nothing is processed until the main loop runs.
+ */
+void
+i3w_test_mock_send(i3wTestMock *mock, const gchar *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    gchar *command = g_strdup_vprintf(format, args);
+    va_end(args);
+
+    gchar *line = g_strconcat(command, "\n", NULL);
+    gsize len = strlen(line), done = 0;
+    while (done < len)
+    {
+        gssize written = write(mock->input, line + done, len - done);
+        if (written < 0)
+            g_error("Cannot write to mock-i3");
+        done += written;
+    }
+
+    g_free(line);
+    g_free(command);
+}
+
+/**
+ * i3w_test_mock_sync:
+ * @mock: the mock
+ *
+ * Run the main loop until the mock sent the events of all the previous
+ * commands and the plugin handled them.
+ */
+void
+i3w_test_mock_sync(i3wTestMock *mock)
+{
+    mock->synced = FALSE;
+    i3w_test_mock_send(mock, "sync");
+
+    while (!mock->synced)
+        g_main_context_iteration(NULL, TRUE);
+    while (g_main_context_pending(NULL))
+        g_main_context_iteration(NULL, FALSE);
+}
+
+/**
+ * i3w_test_mock_stop:
+ * @mock: the mock
+ *
+ * Shut the mock down like i3 exiting, and free it.
+ */
+void
+i3w_test_mock_stop(i3wTestMock *mock)
+{
+    i3w_test_mock_send(mock, "quit");
+    close(mock->input);
+
+    waitpid(mock->pid, NULL, 0);
+    g_spawn_close_pid(mock->pid);
+
+    g_source_remove(mock->output_watch);
+    close(mock->output);
+    g_free(mock);
+}
+
+/**
+ * i3w_test_helper_start:
+ *
+ * Start the workspace helper from I3W_HELPER on the socket of the test. It
+ * exits together with the mock.
+ */
+void
+i3w_test_helper_start(void)
+{
+    GError *err = NULL;
+    gchar *argv[] = { (gchar *) g_getenv("I3W_HELPER"), (gchar *) g_getenv("I3SOCK"), NULL };
+
+    if (!argv[0])
+        g_error("I3W_HELPER is not set");
+
+    if (!g_spawn_async(NULL, argv, NULL, G_SPAWN_DEFAULT, NULL, NULL, NULL, &err))
+        g_error("Cannot start the workspace helper: %s", err->message);
+}
+
+/**
+ * i3w_test_plugin_new:
+ *
+ * Load the plugin module from I3W_PLUGIN_MODULE and construct the plugin
+ * the way the panel does, in a window of its own.
+ *
+ * Returns: the window of the plugin
+ */
+GtkWidget *
+i3w_test_plugin_new(void)
+{
+    const gchar *path = g_getenv("I3W_PLUGIN_MODULE");
+    gpointer symbol = NULL;
+
+    if (!path)
+        g_error("I3W_PLUGIN_MODULE is not set");
+
+    GModule *module = g_module_open(path, G_MODULE_BIND_LOCAL);
+    if (!module || !g_module_symbol(module, "xfce_panel_module_construct", &symbol))
+        g_error("Cannot load the plugin: %s", g_module_error());
+    g_module_make_resident(module);
+
+    XfcePanelPlugin *plugin = ((ConstructFunc) symbol)(PLUGIN_NAME, PLUGIN_ID,
+            "i3 Workspaces", NULL, NULL, gdk_screen_get_default());
+    if (!plugin)
+        g_error("Cannot construct the plugin");
+
+    GtkWidget *window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_container_add(GTK_CONTAINER(window), GTK_WIDGET(plugin));
+    gtk_widget_show(GTK_WIDGET(plugin));
+    gtk_widget_show(window);
+
+    return window;
+}
+
+/**
+ * i3w_test_run:
+ * @ms: how long to run
+ *
+ * Run the main loop for a while. Ending it costs one wakeup.
+ */
+void
+i3w_test_run(guint ms)
+{
+    GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+
+    g_timeout_add(ms, quit_loop, loop);
+    g_main_loop_run(loop);
+    g_main_loop_unref(loop);
+}
+
+/**
+ * i3w_test_measure:
+ * @seconds: the length of the window
+ * @usage: return location for what the process used
+ *
+ * Run the main loop for a fixed window and measure the wakeups, the context
+ * switches and the CPU time spent meanwhile, less the wakeup ending the
+ * window.
+ */
+void
+i3w_test_measure(guint seconds, i3wTestUsage *usage)
+{
+    struct rusage before, after;
+    guint start = wakeups;
+
+    getrusage(RUSAGE_SELF, &before);
+    i3w_test_run(seconds * 1000);
+    getrusage(RUSAGE_SELF, &after);
+
+    usage->wakeups = wakeups - start - 1;
+    usage->switches = after.ru_nvcsw - before.ru_nvcsw;
+    usage->cpu_ms =
+        (after.ru_utime.tv_sec - before.ru_utime.tv_sec) * 1000.0 +
+        (after.ru_utime.tv_usec - before.ru_utime.tv_usec) / 1000.0 +
+        (after.ru_stime.tv_sec - before.ru_stime.tv_sec) * 1000.0 +
+        (after.ru_stime.tv_usec - before.ru_stime.tv_usec) / 1000.0;
+}
+
+/**
+ * i3w_test_check:
+ * @what: the name of the measurement
+ * @value: the measured value
+ * @budget: the largest value allowed
+ *
+ * Report the measurement, failing the test if over budget.
+ */
+void
+i3w_test_check(const gchar *what, gdouble value, gdouble budget)
+{
+    gboolean over = value > budget;
+
+    printf("%-40s %10.1f  budget %10.1f%s\n", what, value, budget, over ? "  FAILED" : "");
+    fflush(stdout);
+
+    if (over)
+        failed = TRUE;
+}
+
+/**
+ * i3w_test_finish:
+ *
+ * Remove the directory of the test.
+ *
+ * Returns: the exit status of the test
+ */
+int
+i3w_test_finish(void)
+{
+    remove_dir(test_dir);
+    g_free(test_dir);
+
+    return failed ? 1 : 0;
+}
+
+/*
+ * Implementations of private functions
+ */
+
+/**
+ * counting_poll:
+ * @fds: the descriptors
+ * @nfds: the number of descriptors
+ * @timeout: the timeout in milliseconds
+ *
+ * Poll like GLib does, counting the polls which slept. A poll which does
+ * not block runs for work already pending and is no wakeup.
+ *
+ * Returns: the result of the poll
+ */
+static gint
+counting_poll(GPollFD *fds, guint nfds, gint timeout)
+{
+    gint ret = g_poll(fds, nfds, timeout);
+
+    if (timeout != 0)
+        wakeups++;
+
+    return ret;
+}
+
+/**
+ * on_mock_output:
+ * @fd: the standard output of the mock
+ * @condition: the condition
+ * @data: the mock
+ *
+ * The mock answers "sync" once the events before are sent.
+ *
+ * Returns: G_SOURCE_REMOVE once the mock exited
+ */
+static gboolean
+on_mock_output(gint fd, GIOCondition condition, gpointer data)
+{
+    i3wTestMock *mock = (i3wTestMock *) data;
+    gchar buf[256];
+
+    gssize len = read(fd, buf, sizeof(buf));
+    if (len <= 0)
+    {
+        mock->output_watch = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    if (g_strstr_len(buf, len, "sync"))
+        mock->synced = TRUE;
+
+    return G_SOURCE_CONTINUE;
+}
+
+/**
+ * quit_loop:
+ * @data: the main loop
+ *
+ * Returns: G_SOURCE_REMOVE
+ */
+static gboolean
+quit_loop(gpointer data)
+{
+    g_main_loop_quit((GMainLoop *) data);
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * remove_dir:
+ * @path: the directory
+ *
+ * Remove the directory with everything in it.
+ */
+static void
+remove_dir(const gchar *path)
+{
+    GDir *dir = g_dir_open(path, 0, NULL);
+    const gchar *name;
+
+    if (!dir)
+        return;
+
+    while ((name = g_dir_read_name(dir)) != NULL)
+    {
+        gchar *child = g_build_filename(path, name, NULL);
+        if (g_file_test(child, G_FILE_TEST_IS_DIR) && !g_file_test(child, G_FILE_TEST_IS_SYMLINK))
+            remove_dir(child);
+        else
+            g_unlink(child);
+        g_free(child);
+    }
+    g_dir_close(dir);
+
+    g_rmdir(path);
+}
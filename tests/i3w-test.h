@@ -0,0 +1,74 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I3W_TEST_H__
+#define __I3W_TEST_H__
+
+#include <gtk/gtk.h>
+
+/*
+ * Shared parts of the tests running the plugin module, loaded the way the
+ * panel loads it, against mock-i3 under Xvfb. See tests/Makefile.am for the
+ * environment they expect.
+ */
+
+typedef struct _i3w_test_mock i3wTestMock;
+
+typedef struct _i3w_test_usage
+{
+    // blocking main loop polls which returned, timer dispatches included
+    guint wakeups;
+    // voluntary context switches of all the threads
+    glong switches;
+    gdouble cpu_ms;
+} i3wTestUsage;
+
+void
+i3w_test_init(int *argc, char ***argv, const gchar *rc);
+
+i3wTestMock *
+i3w_test_mock_start(void);
+
+void
+i3w_test_mock_send(i3wTestMock *mock, const gchar *format, ...) G_GNUC_PRINTF(2, 3);
+
+void
+i3w_test_mock_sync(i3wTestMock *mock);
+
+void
+i3w_test_mock_stop(i3wTestMock *mock);
+
+void
+i3w_test_helper_start(void);
+
+GtkWidget *
+i3w_test_plugin_new(void);
+
+void
+i3w_test_run(guint ms);
+
+void
+i3w_test_measure(guint seconds, i3wTestUsage *usage);
+
+void
+i3w_test_check(const gchar *what, gdouble value, gdouble budget);
+
+int
+i3w_test_finish(void);
+
+#endif /* !__I3W_TEST_H__ */
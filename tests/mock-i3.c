@@ -0,0 +1,550 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A quiet stand-in for i3 for the tests: serves the i3 IPC protocol on a
+ * socket with a small workspace model, and changes the model and sends the
+ * events when told to on its standard input, one command per line:
+ *
+ *   add N, remove N, focus N    workspace N appears, goes, gets the focus
+ *   urgent N 0|1                workspace N stops or starts being urgent
+ *   mode NAME                   the binding mode changes
+ *   output                      the outputs change
+ *   sync                        print "sync" once the previous commands
+ *                               are sent
+ *   quit                        send the shutdown event and exit
+ *
+ * Nothing is sent unless asked for, so it never wakes the plugin up.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <glib-unix.h>
+#include <gio/gio.h>
+#include <json-glib/json-glib.h>
+
+#include "i3w-ipc-socket.h"
+
+#define WORKSPACES_MAX 32
+#define OUTPUT "screen"
+#define RECT "{\"x\":0,\"y\":0,\"width\":1024,\"height\":768}"
+
+typedef struct
+{
+    gint fd;
+    guint32 events;
+    GMutex lock;
+} MockClient;
+
+/*
+ * The model and the clients, shared by the main thread and the client
+ * threads
+ */
+static GMutex state_lock;
+static gboolean present[WORKSPACES_MAX + 1];
+static gboolean urgent[WORKSPACES_MAX + 1];
+static gint focused;
+static GPtrArray *clients;
+
+static const gchar *event_names[] =
+{
+    "workspace", "output", "mode", "window", "barconfig_update", "binding",
+    "shutdown", "tick"
+};
+
+/*
+ * Prototypes
+ */
+static gboolean
+on_accept(gint fd, GIOCondition condition, gpointer data);
+static gpointer
+serve_client(gpointer data);
+static gchar *
+handle_request(MockClient *client, guint32 type, const gchar *payload);
+static guint32
+parse_subscription(const gchar *payload);
+static gboolean
+on_command(GIOChannel *channel, GIOCondition condition, gpointer data);
+static gboolean
+run_command(const gchar *line);
+static void
+send_event(guint32 type, const gchar *payload);
+static void
+send_workspace_event(const gchar *change, gint num);
+static void
+append_workspace_con(GString *out, gint num);
+static gchar *
+workspaces_json(void);
+static gchar *
+tree_json(void);
+
+int
+main(int argc, char **argv)
+{
+    struct sockaddr_un addr;
+
+    if (argc != 2 || strlen(argv[1]) >= sizeof(addr.sun_path))
+    {
+        g_printerr("Usage: %s SOCKET\n", argv[0]);
+        return 2;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    g_strlcpy(addr.sun_path, argv[1], sizeof(addr.sun_path));
+    unlink(argv[1]);
+
+    gint fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, 16) < 0)
+    {
+        perror("mock-i3");
+        return 1;
+    }
+
+    gint num;
+    for (num = 1; num <= 4; num++)
+        present[num] = TRUE;
+    focused = 1;
+    clients = g_ptr_array_new();
+
+    GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+    g_unix_fd_add(fd, G_IO_IN, on_accept, NULL);
+
+    GIOChannel *input = g_io_channel_unix_new(STDIN_FILENO);
+    g_io_add_watch(input, G_IO_IN | G_IO_HUP | G_IO_ERR, on_command, loop);
+
+    g_main_loop_run(loop);
+
+    send_event(I3W_IPC_EVENT_SHUTDOWN, "{\"change\":\"exit\"}");
+
+    g_mutex_lock(&state_lock);
+    guint i;
+    for (i = 0; i < clients->len; i++)
+        shutdown(((MockClient *) clients->pdata[i])->fd, SHUT_RDWR);
+    g_mutex_unlock(&state_lock);
+
+    close(fd);
+    unlink(argv[1]);
+
+    return 0;
+}
+
+/**
+ * on_accept:
+ * @fd: the listening socket
+ * @condition: the condition
+ * @data: unused
+ *
+ * Serve a new client from its own thread.
+ *
+ * Returns: G_SOURCE_CONTINUE
+ */
+static gboolean
+on_accept(gint fd, GIOCondition condition, gpointer data)
+{
+    gint client_fd = accept(fd, NULL, NULL);
+    if (client_fd < 0)
+        return G_SOURCE_CONTINUE;
+
+    MockClient *client = g_new0(MockClient, 1);
+    client->fd = client_fd;
+    g_mutex_init(&client->lock);
+
+    g_mutex_lock(&state_lock);
+    g_ptr_array_add(clients, client);
+    g_mutex_unlock(&state_lock);
+
+    g_thread_unref(g_thread_new("mock-i3-client", serve_client, client));
+
+    return G_SOURCE_CONTINUE;
+}
+
+/**
+ * serve_client:
+ * @data: the client
+ *
+ * Answer the requests of the client until it goes away.
+ *
+ * Returns: NULL
+ */
+static gpointer
+serve_client(gpointer data)
+{
+    MockClient *client = (MockClient *) data;
+    guint32 type;
+    gchar *payload;
+
+    while ((payload = i3w_ipc_recv(client->fd, &type, NULL)) != NULL)
+    {
+        gchar *reply = handle_request(client, type, payload);
+
+        g_mutex_lock(&client->lock);
+        i3w_ipc_send(client->fd, type, reply, NULL);
+        g_mutex_unlock(&client->lock);
+
+        g_free(reply);
+        g_free(payload);
+    }
+
+    g_mutex_lock(&state_lock);
+    g_ptr_array_remove(clients, client);
+    g_mutex_unlock(&state_lock);
+
+    close(client->fd);
+    g_mutex_clear(&client->lock);
+    g_free(client);
+
+    return NULL;
+}
+
+/**
+ * handle_request:
+ * @client: the client
+ * @type: the message type
+ * @payload: the payload of the request
+ *
+ * Returns: the reply, free with g_free()
+ */
+static gchar *
+handle_request(MockClient *client, guint32 type, const gchar *payload)
+{
+    gchar *reply;
+
+    g_mutex_lock(&state_lock);
+    switch (type)
+    {
+        case I3W_IPC_COMMAND:
+            reply = g_strdup("[{\"success\":true}]");
+            break;
+        case I3W_IPC_GET_WORKSPACES:
+            reply = workspaces_json();
+            break;
+        case I3W_IPC_SUBSCRIBE:
+            client->events |= parse_subscription(payload);
+            reply = g_strdup("{\"success\":true}");
+            break;
+        case I3W_IPC_GET_OUTPUTS:
+            reply = g_strdup_printf("[{\"name\":\"" OUTPUT "\",\"active\":true,\"primary\":true,"
+                    "\"current_workspace\":\"%d\",\"rect\":" RECT "}]", focused);
+            break;
+        case I3W_IPC_GET_TREE:
+            reply = tree_json();
+            break;
+        case 6: // GET_BAR_CONFIG
+            reply = payload[0] ? g_strdup_printf("{\"id\":\"%s\",\"colors\":{}}", payload)
+                : g_strdup("[]");
+            break;
+        case 7: // GET_VERSION
+            reply = g_strdup("{\"major\":4,\"minor\":22,\"patch\":0,"
+                    "\"human_readable\":\"4.22 (mock)\",\"loaded_config_file_name\":\"\"}");
+            break;
+        case 8: // GET_BINDING_MODES
+            reply = g_strdup("[\"default\"]");
+            break;
+        case 9: // GET_CONFIG
+            reply = g_strdup("{\"config\":\"\"}");
+            break;
+        default:
+            reply = g_strdup("{\"success\":true}");
+            break;
+    }
+    g_mutex_unlock(&state_lock);
+
+    return reply;
+}
+
+/**
+ * parse_subscription:
+ * @payload: the JSON array of the event names
+ *
+ * Returns: the bits of the events, indexed by i3wIpcEventType
+ */
+static guint32
+parse_subscription(const gchar *payload)
+{
+    JsonParser *parser = json_parser_new();
+    guint32 events = 0;
+
+    if (json_parser_load_from_data(parser, payload, -1, NULL) &&
+        JSON_NODE_HOLDS_ARRAY(json_parser_get_root(parser)))
+    {
+        JsonArray *names = json_node_get_array(json_parser_get_root(parser));
+        guint i, j;
+
+        for (i = 0; i < json_array_get_length(names); i++)
+        {
+            const gchar *name = json_array_get_string_element(names, i);
+            for (j = 0; j < G_N_ELEMENTS(event_names); j++)
+            {
+                if (g_strcmp0(name, event_names[j]) == 0)
+                    events |= 1u << j;
+            }
+        }
+    }
+    g_object_unref(parser);
+
+    return events;
+}
+
+/**
+ * on_command:
+ * @channel: the standard input
+ * @condition: the condition
+ * @data: the main loop
+ *
+ * Run the commands from the standard input, quitting at its end.
+ *
+ * Returns: G_SOURCE_REMOVE once quitting
+ */
+static gboolean
+on_command(GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+    gchar *line = NULL;
+
+    if (g_io_channel_read_line(channel, &line, NULL, NULL, NULL) != G_IO_STATUS_NORMAL ||
+        !run_command(g_strstrip(line)))
+    {
+        g_free(line);
+        g_main_loop_quit((GMainLoop *) data);
+        return G_SOURCE_REMOVE;
+    }
+
+    g_free(line);
+    return G_SOURCE_CONTINUE;
+}
+
+/**
+ * run_command:
+ * @line: the command
+ *
+ * Returns: FALSE on quit
+ */
+static gboolean
+run_command(const gchar *line)
+{
+    gchar **argv = g_strsplit(line, " ", 3);
+    gint num = argv[0] && argv[1] ? atoi(argv[1]) : 0;
+    gboolean valid = num > 0 && num <= WORKSPACES_MAX;
+    gboolean quit = FALSE;
+
+    if (g_strcmp0(argv[0], "quit") == 0)
+    {
+        quit = TRUE;
+    }
+    else if (g_strcmp0(argv[0], "sync") == 0)
+    {
+        printf("sync\n");
+        fflush(stdout);
+    }
+    else if (g_strcmp0(argv[0], "mode") == 0 && argv[1])
+    {
+        gchar *payload = g_strdup_printf("{\"change\":\"%s\",\"pango_markup\":false}", argv[1]);
+        send_event(I3W_IPC_EVENT_MODE, payload);
+        g_free(payload);
+    }
+    else if (g_strcmp0(argv[0], "output") == 0)
+    {
+        send_event(I3W_IPC_EVENT_OUTPUT, "{\"change\":\"unspecified\"}");
+    }
+    else if (g_strcmp0(argv[0], "add") == 0 && valid)
+    {
+        g_mutex_lock(&state_lock);
+        present[num] = TRUE;
+        g_mutex_unlock(&state_lock);
+        send_workspace_event("init", num);
+    }
+    else if (g_strcmp0(argv[0], "remove") == 0 && valid && num != focused)
+    {
+        g_mutex_lock(&state_lock);
+        present[num] = FALSE;
+        urgent[num] = FALSE;
+        g_mutex_unlock(&state_lock);
+        send_workspace_event("empty", num);
+    }
+    else if (g_strcmp0(argv[0], "focus") == 0 && valid)
+    {
+        g_mutex_lock(&state_lock);
+        present[num] = TRUE;
+        focused = num;
+        g_mutex_unlock(&state_lock);
+        send_workspace_event("focus", num);
+    }
+    else if (g_strcmp0(argv[0], "urgent") == 0 && valid && argv[2])
+    {
+        g_mutex_lock(&state_lock);
+        urgent[num] = atoi(argv[2]) != 0;
+        g_mutex_unlock(&state_lock);
+        send_workspace_event("urgent", num);
+    }
+    else if (line[0])
+    {
+        g_printerr("mock-i3: ignoring \"%s\"\n", line);
+    }
+
+    g_strfreev(argv);
+    return !quit;
+}
+
+/**
+ * send_event:
+ * @type: the event type
+ * @payload: the payload of the event
+ *
+ * Send the event to the clients subscribed to it.
+ */
+static void
+send_event(guint32 type, const gchar *payload)
+{
+    guint i;
+
+    g_mutex_lock(&state_lock);
+    for (i = 0; i < clients->len; i++)
+    {
+        MockClient *client = (MockClient *) clients->pdata[i];
+        if (!(client->events & (1u << type)))
+            continue;
+
+        g_mutex_lock(&client->lock);
+        i3w_ipc_send(client->fd, I3W_IPC_EVENT_MASK | type, payload, NULL);
+        g_mutex_unlock(&client->lock);
+    }
+    g_mutex_unlock(&state_lock);
+}
+
+/**
+ * send_workspace_event:
+ * @change: the change
+ * @num: the workspace the event is about
+ */
+static void
+send_workspace_event(const gchar *change, gint num)
+{
+    GString *payload = g_string_new(NULL);
+
+    g_mutex_lock(&state_lock);
+    g_string_append_printf(payload, "{\"change\":\"%s\",\"current\":", change);
+    append_workspace_con(payload, num);
+    g_string_append(payload, ",\"old\":null}");
+    g_mutex_unlock(&state_lock);
+
+    send_event(I3W_IPC_EVENT_WORKSPACE, payload->str);
+    g_string_free(payload, TRUE);
+}
+
+/**
+ * append_workspace_con:
+ * @out: the JSON being built
+ * @num: the workspace
+ *
+ * Append the workspace as a container of the layout tree, with all the
+ * members i3ipc-glib reads.
+ */
+static void
+append_workspace_con(GString *out, gint num)
+{
+    g_string_append_printf(out,
+            "{\"id\":%d,\"type\":\"workspace\",\"name\":\"%d\",\"num\":%d,"
+            "\"focused\":false,\"urgent\":%s,\"layout\":\"splith\","
+            "\"orientation\":\"horizontal\",\"border\":\"normal\","
+            "\"current_border_width\":-1,\"percent\":null,\"window\":null,"
+            "\"fullscreen_mode\":0,\"scratchpad_state\":\"none\",\"sticky\":false,"
+            "\"output\":\"" OUTPUT "\",\"rect\":" RECT ",\"window_rect\":" RECT ","
+            "\"deco_rect\":" RECT ",\"geometry\":" RECT ",\"marks\":[],\"focus\":[],"
+            "\"nodes\":[],\"floating_nodes\":[]}",
+            100 + num, num, num, urgent[num] ? "true" : "false");
+}
+
+/**
+ * workspaces_json:
+ *
+ * Returns: the reply to GET_WORKSPACES, free with g_free()
+ */
+static gchar *
+workspaces_json(void)
+{
+    GString *out = g_string_new("[");
+    gint num;
+
+    for (num = 1; num <= WORKSPACES_MAX; num++)
+    {
+        if (!present[num])
+            continue;
+
+        if (out->len > 1)
+            g_string_append_c(out, ',');
+        g_string_append_printf(out,
+                "{\"id\":%d,\"num\":%d,\"name\":\"%d\",\"visible\":%s,\"focused\":%s,"
+                "\"urgent\":%s,\"output\":\"" OUTPUT "\",\"rect\":" RECT "}",
+                100 + num, num, num,
+                num == focused ? "true" : "false",
+                num == focused ? "true" : "false",
+                urgent[num] ? "true" : "false");
+    }
+    g_string_append_c(out, ']');
+
+    return g_string_free(out, FALSE);
+}
+
+/**
+ * tree_json:
+ *
+ * Returns: the reply to GET_TREE: the root, one output and its
+ * workspaces, without any windows. Free with g_free().
+ */
+static gchar *
+tree_json(void)
+{
+    GString *out = g_string_new(NULL);
+    gint num;
+
+    const gchar *members =
+            "\"focused\":false,\"urgent\":false,\"layout\":\"splith\","
+            "\"orientation\":\"horizontal\",\"border\":\"normal\","
+            "\"current_border_width\":-1,\"percent\":null,\"window\":null,"
+            "\"fullscreen_mode\":0,\"scratchpad_state\":\"none\",\"sticky\":false,"
+            "\"rect\":" RECT ",\"window_rect\":" RECT ",\"deco_rect\":" RECT ","
+            "\"geometry\":" RECT ",\"marks\":[],\"focus\":[],\"floating_nodes\":[],";
+
+    g_string_append_printf(out, "{\"id\":1,\"type\":\"root\",\"name\":\"root\",%s"
+            "\"nodes\":[{\"id\":2,\"type\":\"output\",\"name\":\"" OUTPUT "\",%s"
+            "\"nodes\":[{\"id\":3,\"type\":\"con\",\"name\":\"content\",%s\"nodes\":[",
+            members, members, members);
+
+    gboolean first = TRUE;
+    for (num = 1; num <= WORKSPACES_MAX; num++)
+    {
+        if (!present[num])
+            continue;
+
+        if (!first)
+            g_string_append_c(out, ',');
+        append_workspace_con(out, num);
+        first = FALSE;
+    }
+    g_string_append(out, "]}]}]}");
+
+    return g_string_free(out, FALSE);
+}
@@ -0,0 +1,31 @@
+#!/bin/sh
+#
+# Run a test under an Xvfb of its own. Exits 77, skipping the test, when
+# Xvfb is not installed.
+#
+
+if ! command -v Xvfb >/dev/null 2>&1; then
+    echo "Xvfb not found, skipping $1"
+    exit 77
+fi
+
+display=99
+while [ -e /tmp/.X$display-lock ]; do
+    display=$((display + 1))
+done
+
+Xvfb :$display -screen 0 1024x768x24 -nolisten tcp >/dev/null 2>&1 &
+xvfb=$!
+trap 'kill $xvfb 2>/dev/null; wait $xvfb 2>/dev/null' EXIT
+
+tries=0
+while [ ! -e /tmp/.X11-unix/X$display ]; do
+    tries=$((tries + 1))
+    if [ $tries -gt 50 ] || ! kill -0 $xvfb 2>/dev/null; then
+        echo "Xvfb did not start"
+        exit 99
+    fi
+    sleep 0.1
+done
+
+DISPLAY=:$display "$@"
@@ -0,0 +1,95 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The plugin must stay silent while nothing changes. Against a quiet
+ * mock-i3, count the main loop wakeups, timer dispatches included, the
+ * context switches of all the threads and the CPU time over a fixed window:
+ * connected, on a panel slid off the screen with an urgent workspace whose
+ * animation must not run, and with i3 gone while the plugin reconnects.
+ * Built a second time with I3W_TEST_HELPER, to get the events from the
+ * workspace helper.
+ */
+
+#include "i3w-test.h"
+
+#ifdef I3W_TEST_HELPER
+#define CONFIG "animate_urgent=true\nshared_helper=true\n"
+#else
+#define CONFIG "animate_urgent=true\n"
+#endif
+
+// longer than the delayed write of the workspace snapshot
+#define SETTLE_MS 6000
+#define WINDOW_S 10
+
+// a quiet plugin sleeps through the whole window, one wakeup of slack;
+// ending the window costs a switch or two
+#define IDLE_WAKEUPS 1
+#define IDLE_SWITCHES 4
+#define IDLE_CPU_MS 20
+
+// backing off from 1 to 32 s, the reconnect timer fires twice in the window
+// after the settle time; polling every second would fire 10 times
+#define ABSENT_WAKEUPS 4
+#define ABSENT_SWITCHES 8
+#define ABSENT_CPU_MS 40
+
+int
+main(int argc, char **argv)
+{
+    i3w_test_init(&argc, &argv, CONFIG);
+
+    i3wTestMock *mock = i3w_test_mock_start();
+#ifdef I3W_TEST_HELPER
+    i3w_test_helper_start();
+#endif
+    GtkWidget *window = i3w_test_plugin_new();
+    i3w_test_run(SETTLE_MS);
+
+    i3wTestUsage usage;
+    i3w_test_measure(WINDOW_S, &usage);
+    i3w_test_check("connected: wakeups", usage.wakeups, IDLE_WAKEUPS);
+    i3w_test_check("connected: context switches", usage.switches, IDLE_SWITCHES);
+    i3w_test_check("connected: cpu ms", usage.cpu_ms, IDLE_CPU_MS);
+
+    // an autohidden panel slides off the screen
+    i3w_test_mock_send(mock, "urgent 3 1");
+    i3w_test_mock_sync(mock);
+    gtk_window_move(GTK_WINDOW(window), -4000, -4000);
+    i3w_test_run(SETTLE_MS);
+
+    i3w_test_measure(WINDOW_S, &usage);
+    i3w_test_check("hidden, urgent: wakeups", usage.wakeups, IDLE_WAKEUPS);
+    i3w_test_check("hidden, urgent: context switches", usage.switches, IDLE_SWITCHES);
+    i3w_test_check("hidden, urgent: cpu ms", usage.cpu_ms, IDLE_CPU_MS);
+
+    gtk_window_move(GTK_WINDOW(window), 0, 0);
+    i3w_test_mock_send(mock, "urgent 3 0");
+    i3w_test_mock_sync(mock);
+
+    i3w_test_mock_stop(mock);
+    i3w_test_run(SETTLE_MS);
+
+    i3w_test_measure(WINDOW_S, &usage);
+    i3w_test_check("i3 absent: wakeups", usage.wakeups, ABSENT_WAKEUPS);
+    i3w_test_check("i3 absent: context switches", usage.switches, ABSENT_SWITCHES);
+    i3w_test_check("i3 absent: cpu ms", usage.cpu_ms, ABSENT_CPU_MS);
+
+    return i3w_test_finish();
+}
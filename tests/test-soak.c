@@ -0,0 +1,182 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The panel runs for weeks, so memory must not grow with the events. Drive
+ * the plugin with synthetic workspace, mode and output events, orientation
+ * changes and reconnects against mock-i3, sampling the resident set and the
+ * allocated heap, and fail when they grow beyond a budget after the warmup.
+ * I3W_SOAK_EVENTS sets the number of events, millions for a release soak.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include <libxfce4panel/libxfce4panel.h>
+
+#include "i3w-test.h"
+
+#define DEFAULT_EVENTS 50000
+#define WARMUP_EVENTS 5000
+#define RECONNECT_EVERY 20000
+#define SAMPLES 10
+#define RECONNECT_MS 2500
+
+#define RSS_BUDGET_KB 2048
+#define HEAP_BUDGET_KB 1024
+
+/*
+ * Prototypes
+ */
+static guint
+send_events(i3wTestMock *mock, XfcePanelPlugin *plugin, guint step);
+static glong
+rss_kb(void);
+static glong
+heap_kb(void);
+
+int
+main(int argc, char **argv)
+{
+    const gchar *env = g_getenv("I3W_SOAK_EVENTS");
+    guint events = env ? strtoul(env, NULL, 10) : DEFAULT_EVENTS;
+    guint interval = MAX(events / SAMPLES, 1);
+    guint sent = 0, step = 0, reconnects = 0;
+    glong rss = 0, heap = 0;
+
+    i3w_test_init(&argc, &argv, NULL);
+
+    i3wTestMock *mock = i3w_test_mock_start();
+    GtkWidget *window = i3w_test_plugin_new();
+    XfcePanelPlugin *plugin = XFCE_PANEL_PLUGIN(gtk_bin_get_child(GTK_BIN(window)));
+    i3w_test_run(RECONNECT_MS);
+
+    while (sent < WARMUP_EVENTS + events)
+    {
+        if (sent >= WARMUP_EVENTS && !rss)
+        {
+            rss = rss_kb();
+            heap = heap_kb();
+            printf("after %u warmup events: rss %ld kB, heap %ld kB\n", sent, rss, heap);
+        }
+
+        if (sent / RECONNECT_EVERY > reconnects)
+        {
+            // i3 restarts
+            reconnects++;
+            i3w_test_mock_stop(mock);
+            i3w_test_run(RECONNECT_MS);
+            mock = i3w_test_mock_start();
+            i3w_test_run(RECONNECT_MS);
+        }
+
+        guint batch = send_events(mock, plugin, step++);
+        i3w_test_mock_sync(mock);
+
+        if (sent >= WARMUP_EVENTS && (sent + batch) / interval > sent / interval)
+            printf("after %u events: rss %ld kB, heap %ld kB\n", sent + batch, rss_kb(), heap_kb());
+        sent += batch;
+    }
+
+    i3w_test_mock_stop(mock);
+    i3w_test_run(RECONNECT_MS);
+
+    i3w_test_check("rss growth kB", rss_kb() - rss, RSS_BUDGET_KB);
+#ifdef __GLIBC__
+    i3w_test_check("heap growth kB", heap_kb() - heap, HEAP_BUDGET_KB);
+#endif
+
+    return i3w_test_finish();
+}
+
+/**
+ * send_events:
+ * @mock: the mock
+ * @plugin: the plugin
+ * @step: the number of batches sent before
+ *
+ * Send a batch of events: a workspace comes, gets the focus, gets urgent,
+ * goes again, the binding mode and the outputs change and the panel turns
+ * around now and then.
+ *
+ * Returns: the number of events sent
+ */
+static guint
+send_events(i3wTestMock *mock, XfcePanelPlugin *plugin, guint step)
+{
+    gint num = 2 + step % 8;
+
+    i3w_test_mock_send(mock, "add %d", num);
+    i3w_test_mock_send(mock, "focus %d", num);
+    i3w_test_mock_send(mock, "urgent %d 1", num % 9 + 1);
+    i3w_test_mock_send(mock, "urgent %d 0", num % 9 + 1);
+    i3w_test_mock_send(mock, "mode %s", step % 2 ? "resize" : "default");
+    i3w_test_mock_send(mock, "focus 1");
+    i3w_test_mock_send(mock, "remove %d", num);
+
+    if (step % 10 != 0)
+        return 7;
+
+    i3w_test_mock_send(mock, "output");
+    g_signal_emit_by_name(plugin, "orientation-changed",
+            step % 20 ? GTK_ORIENTATION_VERTICAL : GTK_ORIENTATION_HORIZONTAL);
+
+    return 8;
+}
+
+/**
+ * rss_kb:
+ *
+ * Returns: the resident set of the process in kB
+ */
+static glong
+rss_kb(void)
+{
+    glong size = 0, resident = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+
+    if (statm)
+    {
+        if (fscanf(statm, "%ld %ld", &size, &resident) != 2)
+            resident = 0;
+        fclose(statm);
+    }
+
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * heap_kb:
+ *
+ * Returns: the heap allocated through malloc in kB, 0 when unknown
+ */
+static glong
+heap_kb(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks / 1024;
+#else
+    return 0;
+#endif
+}
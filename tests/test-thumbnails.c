@@ -0,0 +1,150 @@
+/*  $Id$
+ *
+ *  Copyright (C) 2014 Dénes Botond <dns.botond@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Thumbnails must follow what is drawn rather than the clock: a window
+ * drawn on the visible workspace gives one capture, a screen left alone
+ * none, and going through dozens of workspaces keeps at most the cache size
+ * of them. The captures are read back from the trace of the plugin.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "i3w-test.h"
+
+#define CONFIG "show_thumbnails=true\n"
+
+// longer than the refresh delay of the thumbnails and the trace flush
+#define SETTLE_MS 2500
+#define SWITCH_MS 1500
+
+#define WORKSPACES 30
+#define CACHE_SIZE 16
+
+/*
+ * Prototypes
+ */
+static guint
+read_captures(const gchar *path, guint *max_cached, guint *distinct);
+
+int
+main(int argc, char **argv)
+{
+    guint max_cached, distinct, captures, before;
+    gint num;
+
+    i3w_test_init(&argc, &argv, CONFIG);
+
+    // the plugin opens the trace when constructed
+    const gchar *cache = g_getenv("XDG_CACHE_HOME");
+    g_mkdir_with_parents(cache, 0700);
+    gchar *trace = g_build_filename(cache, "trace.json", NULL);
+    g_setenv("I3W_TRACE", trace, TRUE);
+
+    i3wTestMock *mock = i3w_test_mock_start();
+    i3w_test_plugin_new();
+    i3w_test_run(SETTLE_MS);
+
+    // the visible workspace has no thumbnail yet
+    captures = read_captures(trace, &max_cached, &distinct);
+    i3w_test_check("first captures missing", 1.0 - captures, 0);
+
+    before = captures;
+    i3w_test_run(SETTLE_MS);
+    captures = read_captures(trace, &max_cached, &distinct);
+    i3w_test_check("captures of an idle screen", captures - before, 0);
+
+    GtkWidget *window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_default_size(GTK_WINDOW(window), 200, 200);
+    gtk_widget_show(window);
+
+    before = captures;
+    i3w_test_run(SETTLE_MS);
+    captures = read_captures(trace, &max_cached, &distinct);
+    i3w_test_check("captures of a drawn window", captures - before, 1);
+    i3w_test_check("drawn windows not captured", 1.0 - (captures - before), 0);
+    gtk_widget_destroy(window);
+
+    for (num = 2; num <= WORKSPACES; num++)
+    {
+        i3w_test_mock_send(mock, "focus %d", num);
+        i3w_test_mock_sync(mock);
+        i3w_test_run(SWITCH_MS);
+    }
+    i3w_test_run(SETTLE_MS);
+
+    read_captures(trace, &max_cached, &distinct);
+    i3w_test_check("thumbnails cached", max_cached, CACHE_SIZE);
+    // more workspaces captured than cached, so the eviction did run
+    i3w_test_check("workspaces short of an eviction", CACHE_SIZE + 1.0 - distinct, 0);
+
+    i3w_test_mock_stop(mock);
+    g_free(trace);
+
+    return i3w_test_finish();
+}
+
+/**
+ * read_captures:
+ * @path: the trace file
+ * @max_cached: return location for the largest number of thumbnails cached
+ * @distinct: return location for the number of workspaces captured
+ *
+ * Returns: the number of captures stored so far
+ */
+static guint
+read_captures(const gchar *path, guint *max_cached, guint *distinct)
+{
+    GHashTable *workspaces = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    gchar *contents = NULL;
+    guint captures = 0;
+
+    *max_cached = 0;
+
+    if (g_file_get_contents(path, &contents, NULL, NULL))
+    {
+        gchar **lines = g_strsplit(contents, "\n", -1);
+        gchar **line;
+
+        for (line = lines; *line; line++)
+        {
+            if (!strstr(*line, "\"name\":\"thumbnail_capture\""))
+                continue;
+            captures++;
+
+            const gchar *detail = strstr(*line, "\"detail\":\"");
+            const gchar *cached = strstr(*line, "\"workspaces\":");
+            if (detail)
+            {
+                detail += strlen("\"detail\":\"");
+                g_hash_table_add(workspaces, g_strndup(detail, strcspn(detail, "\"")));
+            }
+            if (cached)
+                *max_cached = MAX(*max_cached, (guint) atoi(cached + strlen("\"workspaces\":")));
+        }
+
+        g_strfreev(lines);
+        g_free(contents);
+    }
+
+    *distinct = g_hash_table_size(workspaces);
+    g_hash_table_destroy(workspaces);
+
+    return captures;
+}